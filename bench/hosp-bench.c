@@ -0,0 +1,324 @@
+/**
+ * Benchmark the library's hot paths against the simulated device.
+ * Unless configured otherwise, the simulated device replies immediately, so the benchmark measures only host-side cost.
+ * Set HOSP_SIM_* environment variables to benchmark with a latency or load profile.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <hidapi.h>
+#include <hosp.h>
+#include "hosp-parse.h"
+#include "hosp-time.h"
+#include "format.h"
+#include "util.h"
+#include "writer.h"
+
+#define HOSP_BENCH_DEFAULT_ITERATIONS 1000000
+#define HOSP_BENCH_DEFAULT_INTERVAL_MS 10
+#define HOSP_BENCH_DEFAULT_COUNT 100
+
+static unsigned long iterations = HOSP_BENCH_DEFAULT_ITERATIONS;
+static unsigned long interval_ms = HOSP_BENCH_DEFAULT_INTERVAL_MS;
+static unsigned long count = HOSP_BENCH_DEFAULT_COUNT;
+
+static const char short_options[] = "hn:i:c:";
+static const struct option long_options[] = {
+  {"help",       no_argument,       NULL, 'h'},
+  {"iterations", required_argument, NULL, 'n'},
+  {"interval",   required_argument, NULL, 'i'},
+  {"count",      required_argument, NULL, 'c'},
+  {0, 0, 0, 0}
+};
+
+__attribute__ ((noreturn))
+static void print_usage(int exit_code) {
+  fprintf(exit_code ? stderr : stdout,
+          "Benchmark the library's hot paths against a simulated ODROID Smart Power.\n"
+          "Set HOSP_SIM_* environment variables to configure the simulated device.\n\n"
+          "Usage: hosp-bench [OPTION]...\n"
+          "Options:\n"
+          "  -h, --help               Print this message and exit\n"
+          "  -n, --iterations=N       Iterations for each throughput benchmark (default=%u)\n"
+          "  -i, --interval=MS        The poll loop interval in milliseconds (default=%u)\n"
+          "  -c, --count=N            The number of poll loop iterations (default=%u)\n",
+          HOSP_BENCH_DEFAULT_ITERATIONS, HOSP_BENCH_DEFAULT_INTERVAL_MS, HOSP_BENCH_DEFAULT_COUNT);
+  exit(exit_code);
+}
+
+static void parse_args(int argc, char** argv) {
+  int c;
+  while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+    switch (c) {
+      case 'h':
+        print_usage(0);
+        break;
+      case 'n':
+        iterations = strtoul(optarg, NULL, 0);
+        break;
+      case 'i':
+        interval_ms = strtoul(optarg, NULL, 0);
+        break;
+      case 'c':
+        count = strtoul(optarg, NULL, 0);
+        break;
+      case '?':
+      default:
+        print_usage(EINVAL);
+        break;
+    }
+  }
+  if (!iterations || !interval_ms || !count) {
+    fprintf(stderr, "Arguments must be > 0\n");
+    print_usage(EINVAL);
+  }
+}
+
+// Returns ns per write/read request pair, or a negative value on failure
+static double bench_request_status(hosp_device* hosp) {
+  unsigned long i;
+  int is_on;
+  uint64_t start = hosp_time_ns();
+  for (i = 0; i < iterations; i++) {
+    if (hosp_request_status_write(hosp) || hosp_request_status_read(hosp, &is_on, NULL)) {
+      return -1;
+    }
+  }
+  return (double) (hosp_time_ns() - start) / (double) iterations;
+}
+
+// Returns ns per write/read request pair, or a negative value on failure
+static double bench_request_data(hosp_device* hosp) {
+  unsigned long i;
+  unsigned int mW;
+  uint64_t start = hosp_time_ns();
+  for (i = 0; i < iterations; i++) {
+    if (hosp_request_data_write(hosp) || hosp_request_data_read(hosp, NULL, NULL, &mW, NULL)) {
+      return -1;
+    }
+  }
+  return (double) (hosp_time_ns() - start) / (double) iterations;
+}
+
+// Returns ns per data reply parsed, or a negative value on failure
+static double bench_parse_data(void) {
+  static const char frame[] = "7 5.000V  1.234 A 6.170W  0.123Wh";
+  unsigned char reply[HOSP_REPLY_SIZE] = { 0 };
+  // keep the results live so the loop isn't optimized away
+  volatile unsigned int sink;
+  unsigned int mV;
+  unsigned int mA;
+  unsigned int mW;
+  unsigned int mWh;
+  unsigned long i;
+  uint64_t start;
+  memcpy(reply, frame, sizeof(frame) - 1);
+  start = hosp_time_ns();
+  for (i = 0; i < iterations; i++) {
+    // vary a digit so the input isn't loop-invariant
+    reply[20] = (unsigned char) ('0' + i % 10);
+    if (hosp_parse_data(reply, &mV, &mA, &mW, &mWh)) {
+      return -1;
+    }
+    sink = mV + mA + mW + mWh;
+  }
+  (void) sink;
+  return (double) (hosp_time_ns() - start) / (double) iterations;
+}
+
+// Returns ns per call, or a negative value on failure
+static double bench_util_get_data(hosp_device* hosp) {
+  unsigned long i;
+  unsigned int mV;
+  unsigned int mA;
+  unsigned int mW;
+  unsigned int mWh;
+  uint64_t start = hosp_time_ns();
+  for (i = 0; i < iterations; i++) {
+    if (hosp_util_get_data(hosp, &mV, &mA, &mW, &mWh)) {
+      return -1;
+    }
+  }
+  return (double) (hosp_time_ns() - start) / (double) iterations;
+}
+
+// Measures how late each poll loop sample starts relative to its deadline, returns 0 on success
+static int bench_poll_jitter(hosp_device* hosp) {
+  uint64_t interval_ns = interval_ms * HOSP_NS_PER_MS;
+  uint64_t deadline = hosp_time_ns();
+  uint64_t late_ns;
+  uint64_t min_ns = UINT64_MAX;
+  uint64_t max_ns = 0;
+  double sum = 0;
+  double sum_sq = 0;
+  double mean;
+  unsigned int mW;
+  unsigned long i;
+  for (i = 0; i < count; i++) {
+    deadline += interval_ns;
+    hosp_time_sleep_until_ns(deadline);
+    late_ns = hosp_time_ns() - deadline;
+    if (hosp_util_get_data(hosp, NULL, NULL, &mW, NULL)) {
+      return -1;
+    }
+    min_ns = late_ns < min_ns ? late_ns : min_ns;
+    max_ns = late_ns > max_ns ? late_ns : max_ns;
+    sum += (double) late_ns;
+    sum_sq += (double) late_ns * (double) late_ns;
+  }
+  mean = sum / (double) count;
+  printf("%-16s interval=%lu ms count=%lu wakeup lateness: min=%.1f us mean=%.1f us max=%.1f us stddev=%.1f us\n",
+         "poll_jitter:", interval_ms, count, (double) min_ns / 1000, mean / 1000, (double) max_ns / 1000,
+         sqrt(fmax(sum_sq / (double) count - mean * mean, 0)) / 1000);
+  return 0;
+}
+
+// How the poll loop overlaps a round's request round trip with emitting rounds
+typedef enum bench_pipeline {
+  // write the request, read the reply, then emit the round
+  BENCH_SEQUENTIAL,
+  // read a reply requested in the previous round, then write the next request and emit the round, so the reading is
+  // an interval old
+  BENCH_PREFETCH
+} bench_pipeline;
+
+// Format a CSV row like hosp-poll and queue it for a writer thread
+static int bench_emit(hosp_writer* writer, const hosp_sample* s) {
+  char row[64];
+  char* ptr = row;
+  ptr = hosp_format_u32(ptr, s->mV);
+  *ptr++ = ',';
+  ptr = hosp_format_u32(ptr, s->mA);
+  *ptr++ = ',';
+  ptr = hosp_format_u32(ptr, s->mW);
+  *ptr++ = ',';
+  ptr = hosp_format_u32(ptr, s->mWh);
+  *ptr++ = '\n';
+  return hosp_writer_push(writer, row, (size_t) (ptr - row));
+}
+
+// Returns 0 on success, -1 if the reply didn't arrive (sets errno)
+static int bench_read(hosp_device* hosp, hosp_sample* s) {
+  int ret;
+  if ((ret = hosp_request_data_read_timeout(hosp, &s->mV, &s->mA, &s->mW, &s->mWh, HOSP_READ_TIMEOUT_MS)) > 0) {
+    errno = ENODATA;
+  }
+  s->timestamp_ns = hosp_time_ns();
+  return ret ? -1 : 0;
+}
+
+// Measures how long each poll loop round keeps the loop busy, and how old its reading is when read (the device
+// measures when the request arrives), returns 0 on success
+static int bench_poll_pipeline(hosp_device* hosp, hosp_writer* writer, bench_pipeline mode, const char* name) {
+  uint64_t interval_ns = interval_ms * HOSP_NS_PER_MS;
+  uint64_t deadline = hosp_time_ns();
+  uint64_t start_ns;
+  uint64_t write_ns = 0;
+  uint64_t busy_ns = 0;
+  uint64_t age_ns = 0;
+  hosp_sample s = { 0 };
+  unsigned long i;
+  for (i = 0; i < count; i++) {
+    deadline += interval_ns;
+    hosp_time_sleep_until_ns(deadline);
+    start_ns = hosp_time_ns();
+    if (mode != BENCH_PREFETCH || !i) {
+      write_ns = hosp_time_ns();
+      if (hosp_request_data_write(hosp)) {
+        return -1;
+      }
+    }
+    if (bench_read(hosp, &s)) {
+      return -1;
+    }
+    age_ns += s.timestamp_ns - write_ns;
+    if (mode == BENCH_PREFETCH && i + 1 < count) {
+      write_ns = hosp_time_ns();
+      if (hosp_request_data_write(hosp)) {
+        return -1;
+      }
+    }
+    if (bench_emit(writer, &s)) {
+      return -1;
+    }
+    busy_ns += hosp_time_ns() - start_ns;
+  }
+  printf("%-16s %-10s interval=%lu ms count=%lu round=%.1f us reading age=%.1f us\n", "poll_pipeline:", name,
+         interval_ms, count, (double) busy_ns / (double) count / 1000, (double) age_ns / (double) count / 1000);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  hosp_device* hosp;
+  hosp_writer* writer;
+  int fd;
+  double status_ns;
+  double data_ns;
+  double parse_ns;
+  double get_ns;
+  int ret = 0;
+
+  parse_args(argc, argv);
+
+  // measure only host-side cost by default
+  setenv("HOSP_SIM_LATENCY_US", "0", 0);
+  if (hid_init() < 0) {
+    fprintf(stderr, "hid_init: %ls\n", hid_error(NULL));
+    return 1;
+  }
+
+  if ((hosp = hosp_open()) == NULL) {
+    perror("Failed to open simulated ODROID Smart Power");
+    ret = errno;
+    goto exit_hid;
+  }
+
+  if ((status_ns = bench_request_status(hosp)) < 0 ||
+      (data_ns = bench_request_data(hosp)) < 0 ||
+      (parse_ns = bench_parse_data()) < 0 ||
+      (get_ns = bench_util_get_data(hosp)) < 0) {
+    ret = errno;
+    perror("Benchmark failed");
+    goto close_hosp;
+  }
+  printf("%-16s %10.1f ns/op\n", "request_status:", status_ns);
+  printf("%-16s %10.1f ns/op\n", "request_data:", data_ns);
+  printf("%-16s %10.1f ns/frame (%.2f M frames/s)\n", "parse_data:", parse_ns, 1000 / parse_ns);
+  printf("%-16s %10.1f ns/op\n", "util_get_data:", get_ns);
+  if (bench_poll_jitter(hosp)) {
+    ret = errno;
+    perror("Poll jitter benchmark failed");
+    goto close_hosp;
+  }
+  // rows are written to /dev/null by a writer thread, like hosp-poll writes them to stdout
+  if ((fd = open("/dev/null", O_WRONLY)) < 0) {
+    ret = errno;
+    perror("/dev/null");
+    goto close_hosp;
+  }
+  if ((writer = hosp_writer_start(fd, count, 64, HOSP_WRITER_BLOCK, HOSP_WRITER_FLUSH_RECORD, 0)) == NULL) {
+    ret = errno;
+    perror("Failed to start output writer");
+    close(fd);
+    goto close_hosp;
+  }
+  if (bench_poll_pipeline(hosp, writer, BENCH_SEQUENTIAL, "sequential") ||
+      bench_poll_pipeline(hosp, writer, BENCH_PREFETCH, "prefetch")) {
+    ret = errno;
+    perror("Poll pipeline benchmark failed");
+  }
+  hosp_writer_stop(writer);
+  close(fd);
+
+close_hosp:
+  hosp_close(hosp);
+exit_hid:
+  hid_exit();
+  return ret;
+}
@@ -0,0 +1,107 @@
+/**
+ * Fuzz the data reply parser, checking it against a simple reference decoder.
+ *
+ * This is a libFuzzer entry point, which AFL++ can also use.
+ * Without libFuzzer, HOSP_FUZZ_MAIN builds a driver that runs the inputs in files given as arguments (or stdin), e.g.,
+ * to reproduce a crash.
+ * The parser unit test also runs its fixed replies through this entry point, to check them against the reference.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hosp-parse.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+// Decode a field the obvious way: optional padding, then "-.---" or digits, a dot, and 1-3 fractional digits
+static int ref_decode(const unsigned char* str, size_t len, unsigned int* val) {
+  uint64_t acc = 0;
+  size_t nint = 0;
+  size_t nfrac = 0;
+  size_t i = 0;
+  while (i < len && str[i] == ' ') {
+    i++;
+  }
+  if (len - i == 5 && !memcmp(&str[i], "-.---", 5)) {
+    *val = 0;
+    return 0;
+  }
+  for (; i < len && str[i] >= '0' && str[i] <= '9'; i++, nint++) {
+    acc = acc * 10 + (uint64_t) (str[i] - '0');
+  }
+  if (!nint || i == len || str[i++] != '.') {
+    return -1;
+  }
+  for (; i < len && str[i] >= '0' && str[i] <= '9'; i++, nfrac++) {
+    acc = acc * 10 + (uint64_t) (str[i] - '0');
+  }
+  if (i != len || !nfrac || nfrac > 3) {
+    return -1;
+  }
+  for (; nfrac < 3; nfrac++) {
+    acc *= 10;
+  }
+  if (acc > UINT32_MAX) {
+    abort();
+  }
+  *val = (unsigned int) acc;
+  return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  static const size_t offsets[4] = { 2, 10, 17, 24 };
+  static const size_t lens[4] = { 5, 5, 6, 7 };
+  unsigned char reply[HOSP_REPLY_SIZE] = { 0 };
+  unsigned int vals[4];
+  unsigned int refs[4];
+  int bad = 0;
+  size_t i;
+  // replies are always a full buffer
+  memcpy(reply, data, size < sizeof(reply) ? size : sizeof(reply));
+  for (i = 0; i < 4; i++) {
+    bad |= ref_decode(&reply[offsets[i]], lens[i], &refs[i]);
+  }
+  if (hosp_parse_data(reply, &vals[0], &vals[1], &vals[2], &vals[3])) {
+    if (!bad) {
+      abort();
+    }
+  } else if (bad || memcmp(vals, refs, sizeof(vals))) {
+    abort();
+  }
+  return 0;
+}
+
+#ifdef HOSP_FUZZ_MAIN
+static int run_file(FILE* f) {
+  unsigned char buf[HOSP_REPLY_SIZE];
+  size_t len = fread(buf, 1, sizeof(buf), f);
+  if (ferror(f)) {
+    return -1;
+  }
+  LLVMFuzzerTestOneInput(buf, len);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  FILE* f;
+  int i;
+  if (argc < 2) {
+    return run_file(stdin) ? 1 : 0;
+  }
+  for (i = 1; i < argc; i++) {
+    if ((f = fopen(argv[i], "rb")) == NULL) {
+      perror(argv[i]);
+      return 1;
+    }
+    if (run_file(f)) {
+      perror(argv[i]);
+      fclose(f);
+      return 1;
+    }
+    fclose(f);
+  }
+  return 0;
+}
+#endif
@@ -0,0 +1,122 @@
+/**
+ * Host-side energy integration for Hardkernel ODROID Smart Power (HOSP) data.
+ *
+ * The device only reports energy in whole mWh, which is too coarse for short measurements, and its counter wraps
+ * after 999.999 Wh.
+ * An energy accumulator integrates power over sample timestamps with the trapezoidal rule in microjoules, carrying the
+ * sub-microjoule remainder so no precision is lost over time.
+ * It also tracks the device's mWh counter, detecting wraps and resets (e.g., when the meter is stopped and started),
+ * and keeps a reconciled, monotonic device energy total to cross-check the integrated energy against.
+ * Gaps in the samples, e.g., while a device is disconnected, can be bridged using the device counter.
+ *
+ * Accumulators are plain structures that may be embedded or allocated on the stack; queries just read a field.
+ * An accumulator is not thread-safe.
+ */
+#ifndef _HOSP_ENERGY_H_
+#define _HOSP_ENERGY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <hosp.h>
+
+// The device mWh counter wraps after this value
+#define HOSP_ENERGY_MWH_MAX 999999U
+#define HOSP_ENERGY_UJ_PER_MWH UINT64_C(3600000)
+
+/**
+ * An energy accumulator.
+ * Fields are private, use the query functions.
+ */
+typedef struct hosp_energy {
+  uint64_t uJ;
+  // numerator of the sub-microjoule remainder, in units of (mW * ns / 2)
+  uint64_t rem;
+  uint64_t last_ns;
+  unsigned int last_mW;
+  unsigned int last_mWh;
+  int has_last;
+  // integrated energy when the device counter last changed
+  uint64_t counter_uJ;
+  uint64_t device_mWh;
+  uint64_t resets;
+  uint64_t wraps;
+  uint64_t gaps;
+  int is_gap;
+} hosp_energy;
+
+/**
+ * Initialize (or reset) an energy accumulator.
+ *
+ * @param energy The accumulator, not NULL
+ */
+void hosp_energy_init(hosp_energy* energy);
+
+/**
+ * Add a sample to an energy accumulator.
+ * Energy is integrated from the previous sample's timestamp; the first sample only sets the starting point.
+ * A sample that isn't newer than the previous one doesn't add energy, but still updates the power and counter.
+ *
+ * @param energy The accumulator, not NULL
+ * @param sample The sample, not NULL
+ */
+void hosp_energy_update(hosp_energy* energy, const hosp_sample* sample);
+
+/**
+ * Mark a gap in the samples, e.g., because the device was disconnected, so the next sample bridges it.
+ * Energy across the gap is integrated as though power changed linearly, then kept within the bounds implied by the
+ * change in the device counter, which keeps counting while only the USB connection is lost.
+ * If the counter went backwards during the gap, it's counted as a reset (never a wrap), and the gap's energy is at
+ * least what the device counted since then.
+ *
+ * @param energy The accumulator, not NULL
+ */
+void hosp_energy_gap(hosp_energy* energy);
+
+/**
+ * Get the energy integrated from sample power values.
+ *
+ * @param energy The accumulator, not NULL
+ * @return The energy in microjoules
+ */
+uint64_t hosp_energy_get_uJ(const hosp_energy* energy);
+
+/**
+ * Get the energy counted by the device since the first sample, reconciled across counter wraps and resets.
+ *
+ * @param energy The accumulator, not NULL
+ * @return The energy in mWh
+ */
+uint64_t hosp_energy_get_device_mWh(const hosp_energy* energy);
+
+/**
+ * Get the number of times the device counter wrapped.
+ *
+ * @param energy The accumulator, not NULL
+ * @return The wrap count
+ */
+uint64_t hosp_energy_get_wraps(const hosp_energy* energy);
+
+/**
+ * Get the number of times the device counter was reset, e.g., the meter was stopped and started.
+ *
+ * @param energy The accumulator, not NULL
+ * @return The reset count
+ */
+uint64_t hosp_energy_get_resets(const hosp_energy* energy);
+
+/**
+ * Get the number of gaps bridged.
+ *
+ * @param energy The accumulator, not NULL
+ * @return The gap count
+ */
+uint64_t hosp_energy_get_gaps(const hosp_energy* energy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Manage a group of Hardkernel ODROID Smart Power (HOSP) devices together.
+ *
+ * Data requests are scattered to all devices first, then replies are gathered, so devices service their requests
+ * concurrently and a poll round costs about one device's latency rather than the sum of all of them.
+ */
+#ifndef _HOSP_GROUP_H_
+#define _HOSP_GROUP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <hosp.h>
+
+/**
+ * Opaque HOSP group handle.
+ */
+typedef struct hosp_group hosp_group;
+
+/**
+ * Open a group of all HOSP devices found by hosp_enumerate().
+ *
+ * @return A hosp_group handle, or NULL on failure (sets errno)
+ */
+hosp_group* hosp_group_open(void);
+
+/**
+ * Create a group from open device handles.
+ * The devices must remain open for the lifetime of the group, and the user is responsible for closing them after
+ * hosp_group_close().
+ *
+ * @param devices An array of open device handles, not NULL
+ * @param n The number of devices, > 0
+ * @return A hosp_group handle, or NULL on failure (sets errno)
+ */
+hosp_group* hosp_group_create(hosp_device** devices, size_t n);
+
+/**
+ * Close a group handle, including any devices it opened.
+ *
+ * @param group A group handle, not NULL
+ * @return 0 on success, a negative value on failure (sets errno)
+ */
+int hosp_group_close(hosp_group* group);
+
+/**
+ * Get the number of devices in the group.
+ *
+ * @param group A group handle, not NULL
+ * @return The number of devices
+ */
+size_t hosp_group_size(const hosp_group* group);
+
+/**
+ * Get a device in the group.
+ *
+ * @param group A group handle, not NULL
+ * @param i The device index, < hosp_group_size()
+ * @return The device handle
+ */
+hosp_device* hosp_group_get_device(hosp_group* group, size_t i);
+
+/**
+ * Write to each device that doesn't already have an outstanding request to request data.
+ *
+ * @param group A group handle, not NULL
+ * @return 0 on success, a negative value if any write failed (sets errno)
+ */
+int hosp_group_request_data_write(hosp_group* group);
+
+/**
+ * Read the replies to outstanding data requests from all devices, waiting up to a shared timeout.
+ * Once read, a request is no longer outstanding, whether it was successful or not.
+ *
+ * Each device's status is set to 0 on success, a negative errno value on failure (including a failed write), or a
+ * positive value if the timeout expired before the device replied.
+ * Samples are only set for devices whose status is 0.
+ *
+ * @param group A group handle, not NULL
+ * @param samples A sample array with hosp_group_size() elements, not NULL
+ * @param status A status array with hosp_group_size() elements, not NULL
+ * @param timeout_ms The maximum time to wait in milliseconds, 0 to not wait, or -1 to wait indefinitely
+ * @return The number of devices read successfully
+ */
+size_t hosp_group_request_data_read_timeout(hosp_group* group, hosp_sample* samples, int* status, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * A fixed-record binary log format for Hardkernel ODROID Smart Power (HOSP) data, with a memory-mapped reader.
+ *
+ * A log starts with a header, followed by fixed-size records, one per poll round.
+ * All integers are little-endian.
+ *
+ * Header (HOSP_LOG_HEADER_SIZE bytes):
+ *   char[8]  magic: HOSP_LOG_MAGIC, NUL-padded
+ *   uint32_t version: HOSP_LOG_VERSION
+ *   uint32_t header size: HOSP_LOG_HEADER_SIZE
+ *   uint32_t record size: HOSP_LOG_RECORD_SIZE(num_devices)
+ *   uint32_t num_devices
+ *   uint8_t[8] reserved: zeroes
+ *
+ * Record:
+ *   uint64_t timestamp_ns (CLOCK_MONOTONIC), non-decreasing from record to record
+ *   for each device: uint32_t mV, mA, mW, mWh, all set to HOSP_LOG_INVALID if the device had no data for the round
+ *
+ * The reader memory-maps the log file, so opening a log of any size is constant time, accessing a record by index is
+ * O(1), and finding a record by timestamp is a binary search.
+ * A partial record at the end of the file (e.g., if the writer was interrupted) is ignored.
+ */
+#ifndef _HOSP_LOG_H_
+#define _HOSP_LOG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hosp.h>
+
+#define HOSP_LOG_MAGIC "HOSPLOG"
+#define HOSP_LOG_VERSION 1
+#define HOSP_LOG_HEADER_SIZE 32
+#define HOSP_LOG_RECORD_SIZE(num_devices) (8 + 16 * (num_devices))
+#define HOSP_LOG_INVALID 0xFFFFFFFFU
+
+/**
+ * Opaque log reader handle.
+ */
+typedef struct hosp_log hosp_log;
+
+/**
+ * Encode a log header.
+ *
+ * @param buf The output buffer, at least HOSP_LOG_HEADER_SIZE bytes, not NULL
+ * @param num_devices The number of devices in each record, > 0
+ * @return The number of bytes written to buf
+ */
+size_t hosp_log_encode_header(unsigned char* buf, uint32_t num_devices);
+
+/**
+ * Encode a log record.
+ *
+ * @param buf The output buffer, at least HOSP_LOG_RECORD_SIZE(n) bytes, not NULL
+ * @param timestamp_ns The record timestamp
+ * @param samples The device samples, not NULL (their timestamps are ignored)
+ * @param status Optional per-device status; devices with a non-zero status are recorded as HOSP_LOG_INVALID
+ * @param n The number of devices
+ * @return The number of bytes written to buf
+ */
+size_t hosp_log_encode_record(unsigned char* buf, uint64_t timestamp_ns, const hosp_sample* samples, const int* status,
+                              size_t n);
+
+/**
+ * Open a log file for reading.
+ *
+ * @param path The log file path, not NULL
+ * @return A hosp_log handle, or NULL on failure (sets errno)
+ */
+hosp_log* hosp_log_open(const char* path);
+
+/**
+ * Close a log reader handle.
+ *
+ * @param log A log handle, not NULL
+ * @return 0 on success, a negative value on failure (sets errno)
+ */
+int hosp_log_close(hosp_log* log);
+
+/**
+ * Get the number of devices in each record.
+ *
+ * @param log A log handle, not NULL
+ * @return The number of devices
+ */
+size_t hosp_log_get_num_devices(const hosp_log* log);
+
+/**
+ * Get the number of complete records in the log.
+ *
+ * @param log A log handle, not NULL
+ * @return The number of records
+ */
+size_t hosp_log_get_count(const hosp_log* log);
+
+/**
+ * Get a record's timestamp.
+ *
+ * @param log A log handle, not NULL
+ * @param i The record index, < hosp_log_get_count()
+ * @return The timestamp in nanoseconds
+ */
+uint64_t hosp_log_get_timestamp(const hosp_log* log, size_t i);
+
+/**
+ * Get a device's sample from a record.
+ *
+ * @param log A log handle, not NULL
+ * @param i The record index
+ * @param device The device index
+ * @param sample The sample to set, not NULL
+ * @return 0 on success, a negative value on failure (sets errno), a positive value if the device had no data
+ */
+int hosp_log_get(const hosp_log* log, size_t i, size_t device, hosp_sample* sample);
+
+/**
+ * Find the first record with a timestamp at or after the given time.
+ *
+ * @param log A log handle, not NULL
+ * @param timestamp_ns The time to search for
+ * @return The record index, or hosp_log_get_count() if all records are earlier
+ */
+size_t hosp_log_find(const hosp_log* log, uint64_t timestamp_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
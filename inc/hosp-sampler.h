@@ -0,0 +1,125 @@
+/**
+ * A background sampler for a Hardkernel ODROID Smart Power (HOSP) device.
+ *
+ * The sampler owns a dedicated thread that polls the device at a fixed interval, using absolute deadlines so the
+ * sampling period doesn't drift, and pushes timestamped samples into a single-producer/multi-consumer ring buffer.
+ * Consumers drain the ring in batches without locks or system calls.
+ * Each consumer tracks its own position in the ring with a sequence number cursor, so any number of consumers may read
+ * concurrently and independently.
+ * The ring never blocks the sampler: if a consumer falls more than the ring capacity behind, the oldest samples are
+ * overwritten and the consumer's cursor skips ahead.
+ *
+ * While a sampler is running, its thread makes synchronous data requests on the hosp_device, so other threads may share
+ * the handle under its usual rules (see hosp.h): they may make their own requests, which are answered in turn with the
+ * sampler's, but must not use the hosp_async_*() functions or call hosp_close(), hosp_reopen(), or hosp_disconnect()
+ * until the sampler is stopped.
+ *
+ * Regions measure the energy used by code between hosp_region_begin() and hosp_region_end(), integrating the sampler's
+ * power samples and interpolating between them at the region's boundaries.
+ * Each region's state is owned by the caller, and beginning or ending one only reads the sampler's latest state and at
+ * most one sample from the ring, without locks or system calls other than reading the clock.
+ * Any number of regions may be active at once, including nested and overlapping regions in different threads.
+ */
+#ifndef _HOSP_SAMPLER_H_
+#define _HOSP_SAMPLER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hosp.h>
+
+/**
+ * Opaque sampler handle.
+ */
+typedef struct hosp_sampler hosp_sampler;
+
+/**
+ * Energy measurement region state, set by hosp_region_begin().
+ */
+typedef struct hosp_region {
+  uint64_t start_ns;
+  // the latest sample when the region began, and the sampler's cumulative energy at that sample
+  uint64_t seq;
+  uint64_t sample_ns;
+  uint64_t uJ;
+  unsigned int mW;
+} hosp_region;
+
+/**
+ * Start sampling data in a background thread.
+ *
+ * @param hosp An open device handle, not NULL
+ * @param interval_ms The sampling interval in milliseconds, > 0
+ * @param capacity The number of samples retained by the ring buffer, > 0
+ * @return A hosp_sampler handle, or NULL on failure (sets errno)
+ */
+hosp_sampler* hosp_sampler_start(hosp_device* hosp, unsigned long interval_ms, size_t capacity);
+
+/**
+ * Stop the sampler thread and destroy the handle.
+ * The device may be used again after this function returns.
+ *
+ * @param sampler A sampler handle, not NULL
+ * @return 0 on success, a negative value on failure (sets errno)
+ */
+int hosp_sampler_stop(hosp_sampler* sampler);
+
+/**
+ * Get the sequence number that will be assigned to the next sample.
+ * Use as a cursor for hosp_sampler_read() to only read samples collected from now on.
+ * Sequence numbers start at 0 and increase by 1 for each sample.
+ *
+ * @param sampler A sampler handle, not NULL
+ * @return The next sequence number
+ */
+uint64_t hosp_sampler_get_seq(const hosp_sampler* sampler);
+
+/**
+ * Read a batch of samples without blocking.
+ *
+ * The cursor is the sequence number of the next sample to read and is advanced past the samples returned.
+ * If samples at the cursor have already been overwritten, the cursor first skips ahead to the oldest sample still
+ * available; callers can detect lost samples by comparing the cursor before and after the call with the count.
+ *
+ * @param sampler A sampler handle, not NULL
+ * @param cursor The sequence number to read from, updated on return, not NULL
+ * @param samples The sample buffer, not NULL
+ * @param len The number of elements in the sample buffer
+ * @return The number of samples read, 0 if none are available yet
+ */
+size_t hosp_sampler_read(hosp_sampler* sampler, uint64_t* cursor, hosp_sample* samples, size_t len);
+
+/**
+ * Begin an energy measurement region.
+ *
+ * @param sampler A sampler handle, not NULL
+ * @param region The region to begin, not NULL
+ * @return 0 on success, a negative value on failure (sets errno), e.g., ENODATA if there's no sample yet
+ */
+int hosp_region_begin(const hosp_sampler* sampler, hosp_region* region);
+
+/**
+ * End an energy measurement region.
+ *
+ * Power is interpolated linearly between the samples on either side of the region's beginning, if they're both still
+ * in the ring, and held at the latest sample's value until the region's end, since the next sample isn't collected yet.
+ * The region isn't modified, so a region may be ended more than once to get cumulative measurements.
+ *
+ * @param sampler The sampler handle the region began with, not NULL
+ * @param region The region, not NULL
+ * @param uJ The energy used in microjoules, not NULL
+ * @param duration_ns The region's duration in nanoseconds, not NULL
+ * @param mW The average power in milliwatts, not NULL
+ * @return 0 on success, a negative value on failure (sets errno)
+ */
+int hosp_region_end(const hosp_sampler* sampler, const hosp_region* region, uint64_t* uJ, uint64_t* duration_ns,
+                    unsigned int* mW);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
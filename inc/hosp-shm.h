@@ -0,0 +1,108 @@
+/**
+ * Publish Hardkernel ODROID Smart Power (HOSP) samples to local processes through POSIX shared memory.
+ *
+ * A single writer, e.g., the hospd daemon, owns the device and publishes each sample to a named shared memory segment.
+ * The segment holds the latest sample, protected by a seqlock, and a ring buffer of recent samples.
+ * Any number of readers in other processes may map the segment and get samples without system calls, locks, or
+ * contention on the device: readers never block the writer, and only retry if they race with a write in progress.
+ *
+ * The segment layout is versioned, and readers reject segments from an incompatible writer.
+ */
+#ifndef _HOSP_SHM_H_
+#define _HOSP_SHM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hosp.h>
+
+#define HOSP_SHM_DEFAULT_NAME "/hosp"
+#define HOSP_SHM_VERSION 1
+
+/**
+ * Opaque shared memory handle, for either the writer or a reader.
+ */
+typedef struct hosp_shm hosp_shm;
+
+/**
+ * Create a shared memory segment to publish samples to.
+ * Fails with EBUSY if another live process is publishing to a segment with the same name.
+ * A stale segment left behind by a writer that exited without closing it is replaced.
+ *
+ * @param name The POSIX shared memory object name, e.g., HOSP_SHM_DEFAULT_NAME, not NULL
+ * @param capacity The number of recent samples retained, > 0
+ * @param interval_ms The writer's sampling interval in milliseconds, for readers' information
+ * @return A hosp_shm writer handle, or NULL on failure (sets errno)
+ */
+hosp_shm* hosp_shm_create(const char* name, size_t capacity, unsigned long interval_ms);
+
+/**
+ * Open an existing shared memory segment to read samples from.
+ *
+ * @param name The POSIX shared memory object name, not NULL
+ * @return A hosp_shm reader handle, or NULL on failure (sets errno)
+ */
+hosp_shm* hosp_shm_open(const char* name);
+
+/**
+ * Close a shared memory handle.
+ * Closing the writer handle also removes the segment's name, but readers may continue to use their mappings.
+ *
+ * @param shm A shared memory handle, not NULL
+ * @return 0 on success, a negative value on failure (sets errno)
+ */
+int hosp_shm_close(hosp_shm* shm);
+
+/**
+ * Publish a sample, updating the latest sample and appending it to the ring.
+ * Only the writer may publish.
+ *
+ * @param shm A shared memory writer handle, not NULL
+ * @param sample The sample, not NULL
+ */
+void hosp_shm_publish(hosp_shm* shm, const hosp_sample* sample);
+
+/**
+ * Get the latest sample.
+ *
+ * @param shm A shared memory handle, not NULL
+ * @param sample The sample to set, not NULL
+ * @return 0 on success, a negative value on failure (sets errno), a positive value if no sample is published yet
+ */
+int hosp_shm_get_latest(const hosp_shm* shm, hosp_sample* sample);
+
+/**
+ * Get the sequence number of the next sample to be published, i.e., the number of samples published so far.
+ *
+ * @param shm A shared memory handle, not NULL
+ * @return The sequence number
+ */
+uint64_t hosp_shm_get_seq(const hosp_shm* shm);
+
+/**
+ * Get the writer's sampling interval.
+ *
+ * @param shm A shared memory handle, not NULL
+ * @return The interval in milliseconds
+ */
+unsigned long hosp_shm_get_interval_ms(const hosp_shm* shm);
+
+/**
+ * Read published samples from the ring, with the same semantics as hosp_sampler_read().
+ *
+ * @param shm A shared memory handle, not NULL
+ * @param cursor The sequence number of the next sample to read, advanced past the samples read, not NULL
+ * @param samples The output buffer, not NULL
+ * @param len The maximum number of samples to read
+ * @return The number of samples read
+ */
+size_t hosp_shm_read(const hosp_shm* shm, uint64_t* cursor, hosp_sample* samples, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -16,6 +16,20 @@
  * Data is not always available on read requests, in which case clients should wait for a period, then try again.
  * This write/read protocol is left exposed in this API so the library does not have to perform undesirable sleep
  * operations between write and read while also allowing users to implement their own retry algorithms.
+ * Alternatively, the *_read_timeout() variants block until the reply arrives (or the timeout expires), avoiding
+ * sleep-and-retry loops altogether.
+ * When the timeout expires, the request is abandoned and its late reply is discarded, so to retry, write a new request.
+ *
+ * For event loops (e.g., epoll, libuv, io_uring), hosp_get_fd() gets a descriptor to poll for readability, and the
+ * hosp_async_*() functions submit requests and collect their replies without blocking or sleeping.
+ *
+ * Handles are thread-safe, so, e.g., a monitoring thread can request the status while a sampling thread requests data.
+ * Replies are routed to the waiting caller by their type, so concurrent requests of different types don't interfere,
+ * and concurrent requests of the same type each get one of the replies.
+ * The exceptions are hosp_close(), hosp_reopen(), and hosp_disconnect(), which must not be called while other threads
+ * use the handle, and the hosp_async_*() functions, which may only be used by one thread, and not while other threads
+ * make requests: another thread reading from the device could take an asynchronous reply, and since the descriptor from
+ * hosp_get_fd() wouldn't become readable for it again, an event loop waiting for it would hang.
  *
  * @author Connor Imes
  * @date 2018-05-22
@@ -28,6 +42,7 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 #include <hidapi.h>
 
 #define HOSP_VENDOR_ID 0x04d8
@@ -38,6 +53,67 @@ extern "C" {
  */
 typedef struct hosp_device hosp_device;
 
+/**
+ * A timestamped data sample.
+ * Timestamps are CLOCK_MONOTONIC time in nanoseconds.
+ */
+typedef struct hosp_sample {
+  uint64_t timestamp_ns;
+  unsigned int mV;
+  unsigned int mA;
+  unsigned int mW;
+  unsigned int mWh;
+} hosp_sample;
+
+/**
+ * Request types that get replies, for asynchronous requests.
+ */
+typedef enum hosp_async_type {
+  HOSP_ASYNC_VERSION,
+  HOSP_ASYNC_STATUS,
+  HOSP_ASYNC_DATA
+} hosp_async_type;
+
+/**
+ * The reply to an asynchronous request.
+ * Only the fields for the request type are set.
+ */
+typedef struct hosp_async_result {
+  hosp_async_type type;
+  // 0 on success, or a negative error code, e.g., -EBADMSG if a data reply is malformed
+  int status;
+  // HOSP_ASYNC_VERSION
+  char version[17];
+  // HOSP_ASYNC_STATUS
+  int is_on;
+  int is_started;
+  // HOSP_ASYNC_DATA, timestamped when the reply was read
+  hosp_sample sample;
+} hosp_async_result;
+
+// The maximum number of asynchronous requests awaiting replies
+#define HOSP_ASYNC_MAX_PENDING 16
+
+#define HOSP_STATS_LATENCY_BUCKETS 32
+
+/**
+ * Device I/O statistics, accumulated since the device was opened or the statistics were last reset.
+ *
+ * Latency is the time from writing a request to successfully reading its reply, recorded in a log-scale histogram:
+ * bucket 0 counts replies within 1 microsecond, bucket i > 0 counts replies within [2^(i-1), 2^i) microseconds, and
+ * the last bucket also counts anything slower.
+ */
+typedef struct hosp_stats {
+  uint64_t writes;
+  uint64_t write_errors;
+  // successful reads of the requested reply
+  uint64_t reads;
+  // reads where the reply was not yet available (or a read timed out)
+  uint64_t reads_not_ready;
+  uint64_t read_errors;
+  uint64_t latency[HOSP_STATS_LATENCY_BUCKETS];
+} hosp_stats;
+
 /**
  * A wrapper around hid_enumerate() to get only HOSP HID devices.
  * This is likely only needed if the user must disambiguate between multiple HOSP devices connected to the system.
@@ -79,10 +155,56 @@ int hosp_close(hosp_device* hosp);
  * Get the underlying HID device.
  *
  * @param hosp An open device handle, not NULL
- * @return The hid_device pointer
+ * @return The hid_device pointer, or NULL after hosp_disconnect()
  */
 hid_device* hosp_get_device(hosp_device* hosp);
 
+/**
+ * Replace the underlying HID device, e.g., after the old one was disconnected by a USB reset.
+ * Statistics and the cached version are kept, but pending asynchronous requests are forgotten, and any file descriptor
+ * from hosp_get_fd() is no longer valid.
+ *
+ * If the handle opened its HID device, that device is closed once the new one is in place.
+ * Otherwise, the user is responsible for closing the old device after this call.
+ * If the call fails, the handle still uses the old device.
+ *
+ * @param hosp An open device handle, not NULL
+ * @param dev An optional HID device returned from hid_open(); if NULL, the first HOSP device discovered will be used
+ * @return 0 on success, a negative value on failure (sets errno)
+ */
+int hosp_reopen(hosp_device* hosp, hid_device* dev);
+
+/**
+ * Let go of the underlying HID device, e.g., as soon as it's known to be disconnected, so the OS can release it (with
+ * hidraw, a device node stays reserved while it's open, so a device plugged back in would get a different one).
+ * Statistics and the cached version are kept, but pending asynchronous requests are forgotten, and any file descriptor
+ * from hosp_get_fd() is no longer valid.
+ * Until a successful hosp_reopen(), requests fail with ENODEV and hosp_get_device() returns NULL.
+ *
+ * If the handle opened its HID device, that device is closed.
+ * Otherwise, the user is responsible for closing it after this call.
+ *
+ * @param hosp An open device handle, not NULL
+ * @return 0
+ */
+int hosp_disconnect(hosp_device* hosp);
+
+/**
+ * Get the device's I/O statistics.
+ * Safe to call while another thread is using the device, though counters may not be updated all at once.
+ *
+ * @param hosp An open device handle, not NULL
+ * @param stats The statistics to set, not NULL
+ */
+void hosp_get_stats(hosp_device* hosp, hosp_stats* stats);
+
+/**
+ * Reset the device's I/O statistics.
+ *
+ * @param hosp An open device handle, not NULL
+ */
+void hosp_reset_stats(hosp_device* hosp);
+
 /**
  * Write to the device to request the firmware version string.
  *
@@ -101,6 +223,17 @@ int hosp_request_version_write(hosp_device* hosp);
  */
 int hosp_request_version_read(hosp_device* hosp, char* buf, size_t bufsize);
 
+/**
+ * Read from the device to get the firmware version string, waiting up to a timeout for the reply.
+ *
+ * @param hosp An open device handle, not NULL
+ * @param buf Version string buffer, not NULL
+ * @param bufsize Size of version string buffer, should be >= 17
+ * @param timeout_ms The maximum time to wait in milliseconds, 0 to not wait, or -1 to wait indefinitely
+ * @return 0 on success, a negative value on failure (sets errno), a positive value if the timeout expired
+ */
+int hosp_request_version_read_timeout(hosp_device* hosp, char* buf, size_t bufsize, int timeout_ms);
+
 /**
  * Write to the device to request its status.
  *
@@ -120,6 +253,18 @@ int hosp_request_status_write(hosp_device* hosp);
  */
 int hosp_request_status_read(hosp_device* hosp, int* is_on, int* is_started);
 
+/**
+ * Read from the device to get its status, waiting up to a timeout for the reply.
+ * Integer pointers are optional, though presumably at least one of them should not be NULL.
+ *
+ * @param hosp An open device handle, not NULL
+ * @param is_on Optional boolean value to set if device is ON (1) or OFF (0)
+ * @param is_started Optional boolean value to set if device is STARTED (1) or STOPPED (0)
+ * @param timeout_ms The maximum time to wait in milliseconds, 0 to not wait, or -1 to wait indefinitely
+ * @return 0 on success, a negative value on failure (sets errno), a positive value if the timeout expired
+ */
+int hosp_request_status_read_timeout(hosp_device* hosp, int* is_on, int* is_started, int timeout_ms);
+
 /**
  * Write to the device to request to toggle its ON/OFF state.
  *
@@ -154,9 +299,102 @@ int hosp_request_data_write(hosp_device* hosp);
  * @param mW Optional milliwatts value to set
  * @param mWh Optional milliwatt-hours value to set
  * @return 0 on success, a negative value on failure (sets errno), a positive value if result is not yet available
+ *         Fails with EBADMSG if the reply is malformed, in which case no values are set.
  */
 int hosp_request_data_read(hosp_device* hosp, unsigned int* mV, unsigned int* mA, unsigned int* mW, unsigned int* mWh);
 
+/**
+ * Read from the device to get data, waiting up to a timeout for the reply.
+ * Integer pointers are optional, though presumably at least one of them should not be NULL.
+ *
+ * @param hosp An open device handle, not NULL
+ * @param mV Optional millivolts value to set
+ * @param mA Optional milliamps value to set
+ * @param mW Optional milliwatts value to set
+ * @param mWh Optional milliwatt-hours value to set
+ * @param timeout_ms The maximum time to wait in milliseconds, 0 to not wait, or -1 to wait indefinitely
+ * @return 0 on success, a negative value on failure (sets errno), a positive value if the timeout expired
+ *         Fails with EBADMSG if the reply is malformed, in which case no values are set.
+ */
+int hosp_request_data_read_timeout(hosp_device* hosp, unsigned int* mV, unsigned int* mA, unsigned int* mW,
+                                   unsigned int* mWh, int timeout_ms);
+
+/**
+ * Get a file descriptor that's readable while a reply is available, to register with an event loop.
+ * Only supported with HIDAPI's hidraw backend (Linux) and the simulator, otherwise fails with ENOTSUP.
+ * HIDAPI doesn't expose the descriptor, so it's found in HIDAPI's private handle structure, and if what's found there
+ * isn't a hidraw descriptor for a HOSP device, e.g., with an incompatible HIDAPI version, this also fails with ENOTSUP.
+ * Don't read from or close the descriptor; use hosp_async_on_readable().
+ * The descriptor only becomes readable when the device replies, so other threads must not make requests while an event
+ * loop waits on it (see the thread safety notes above).
+ *
+ * @param hosp An open device handle, not NULL
+ * @return A file descriptor, or a negative value on failure (sets errno)
+ */
+int hosp_get_fd(hosp_device* hosp);
+
+/**
+ * Write a request without blocking to wait for its reply.
+ * Requests are answered in order; collect replies with hosp_async_on_readable().
+ * Don't mix asynchronous requests with the other request functions on the same device without hosp_async_reset().
+ *
+ * @param hosp An open device handle, not NULL
+ * @param type The request type
+ * @return 0 on success, a negative value on failure (sets errno), e.g., EBUSY if HOSP_ASYNC_MAX_PENDING requests are
+ *         already awaiting replies
+ */
+int hosp_async_submit(hosp_device* hosp, hosp_async_type type);
+
+/**
+ * Collect the reply to the oldest pending asynchronous request, if available, without blocking.
+ * Call when the descriptor from hosp_get_fd() is readable, or periodically if it's not supported.
+ * More than one reply may be available, so call until it returns 0, e.g., with edge-triggered polling.
+ * Replies that don't match a pending request, e.g., stale replies to requests from before hosp_async_reset(), are
+ * discarded.
+ *
+ * @param hosp An open device handle, not NULL
+ * @param result The result to set, not NULL
+ * @return 1 if a reply was collected, 0 if none is available, or a negative value on failure (sets errno)
+ */
+int hosp_async_on_readable(hosp_device* hosp, hosp_async_result* result);
+
+/**
+ * Get the number of asynchronous requests awaiting replies.
+ *
+ * @param hosp An open device handle, not NULL
+ * @return The number of pending requests
+ */
+size_t hosp_async_pending(const hosp_device* hosp);
+
+/**
+ * Forget pending asynchronous requests, e.g., after they time out.
+ * Late replies to forgotten requests are discarded.
+ *
+ * @param hosp An open device handle, not NULL
+ */
+void hosp_async_reset(hosp_device* hosp);
+
+/**
+ * Get the version, status, and data in one pipelined exchange, waiting up to a timeout for the replies.
+ * All the requests are written before any replies are read, so the exchange costs about one round trip rather than
+ * one per request.
+ * The version is cached by the handle, so it's only requested the first time.
+ * Pointers are optional, and requests are only made for the information requested.
+ *
+ * @param hosp An open device handle, not NULL
+ * @param version Optional version buffer to set
+ * @param bufsize The version buffer size (including the NUL terminator); versions are up to 16 characters long
+ * @param is_on Optional ON/OFF status to set
+ * @param is_started Optional START/STOP status to set
+ * @param sample Optional data sample to set, timestamped when its reply was read
+ * @param timeout_ms The maximum time to wait for all the replies in milliseconds, or -1 to wait indefinitely
+ * @return 0 on success, a negative value on failure (sets errno), a positive value if the timeout expired
+ *         Fails with EBADMSG if the data reply is malformed.
+ *         Values for replies that arrived may be set even if it doesn't succeed.
+ */
+int hosp_snapshot(hosp_device* hosp, char* version, size_t bufsize, int* is_on, int* is_started, hosp_sample* sample,
+                  int timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
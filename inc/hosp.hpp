@@ -0,0 +1,445 @@
+/**
+ * A header-only C++11 wrapper for managing a Hardkernel ODROID Smart Power (HOSP) device.
+ *
+ * hosp::device is a move-only RAII handle that implements the write/read/retry protocol, with timeouts as
+ * std::chrono durations, and reports failures by throwing std::system_error with the errno value set by the C library.
+ * hosp::device::samples() returns a lazy input range that reads a sample per interval as it's iterated, e.g.:
+ *
+ *   hosp::device dev;
+ *   for (const hosp::sample& s : dev.samples(std::chrono::milliseconds(100), 10)) {
+ *     std::cout << s.mW << std::endl;
+ *   }
+ *
+ * Everything is inline, without virtual functions or heap allocations per sample, so it compiles down to the same C
+ * calls a C user would make.
+ *
+ * Like the C API, a device may be shared by threads, except to close, reopen, disconnect, move, or destroy it.
+ */
+#ifndef _HOSP_HPP_
+#define _HOSP_HPP_
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <hidapi.h>
+#include <hosp.h>
+
+namespace hosp {
+
+/**
+ * A timestamped data sample; timestamps are CLOCK_MONOTONIC time in nanoseconds (see timestamp()).
+ */
+using sample = ::hosp_sample;
+
+/**
+ * Device I/O statistics.
+ */
+using stats = ::hosp_stats;
+
+/**
+ * The device's ON/OFF and START/STOP state.
+ */
+struct status {
+  bool on;
+  bool started;
+};
+
+/**
+ * How long to wait for a reply by default.
+ */
+constexpr std::chrono::milliseconds default_timeout{250};
+
+/**
+ * Get a sample's timestamp as a std::chrono::steady_clock time point.
+ * Assumes steady_clock is CLOCK_MONOTONIC, as it is with the GNU and LLVM C++ libraries on Linux.
+ */
+inline std::chrono::steady_clock::time_point timestamp(const sample& s) {
+  return std::chrono::steady_clock::time_point(
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(s.timestamp_ns)));
+}
+
+namespace detail {
+
+[[noreturn]] inline void throw_errno(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Throw on a negative return value; returns it otherwise, so callers can handle timeouts (positive values)
+inline int check(int ret, const char* what) {
+  if (ret < 0) {
+    throw_errno(what);
+  }
+  return ret;
+}
+
+// Convert a timeout to the C API's milliseconds, where a negative duration waits indefinitely, clamping durations too
+// long for an int (over 24 days)
+inline int timeout_ms(std::chrono::milliseconds timeout) {
+  if (timeout.count() < 0) {
+    return -1;
+  }
+  if (timeout.count() > std::numeric_limits<int>::max()) {
+    return std::numeric_limits<int>::max();
+  }
+  return static_cast<int>(timeout.count());
+}
+
+[[noreturn]] inline void throw_timeout(const char* what) {
+  throw std::system_error(ETIMEDOUT, std::generic_category(), what);
+}
+
+} // namespace detail
+
+class sample_range;
+
+/**
+ * A move-only handle for an open HOSP device.
+ * A moved-from device may only be destroyed or assigned to.
+ */
+class device {
+public:
+  /**
+   * Open the first HOSP device discovered.
+   */
+  device() : hosp_(::hosp_open()), hid_(nullptr) {
+    if (hosp_ == nullptr) {
+      detail::throw_errno("hosp_open");
+    }
+  }
+
+  /**
+   * Open a HOSP device using an open HID device, which the caller must close after this device is destroyed.
+   */
+  explicit device(hid_device* dev) : hosp_(::hosp_open_device(dev)), hid_(nullptr) {
+    if (hosp_ == nullptr) {
+      detail::throw_errno("hosp_open_device");
+    }
+  }
+
+  /**
+   * Open the HOSP device at a HID path, e.g., "/dev/hidraw0" with the hidraw backend, which is closed with this device.
+   */
+  explicit device(const char* path) : hosp_(nullptr), hid_(::hid_open_path(path)) {
+    if (hid_ == nullptr) {
+      // HIDAPI doesn't always set errno
+      throw std::system_error(errno ? errno : ENODEV, std::generic_category(), "hid_open_path");
+    }
+    if ((hosp_ = ::hosp_open_device(hid_)) == nullptr) {
+      int err = errno;
+      ::hid_close(hid_);
+      errno = err;
+      detail::throw_errno("hosp_open_device");
+    }
+  }
+
+  device(const device&) = delete;
+  device& operator=(const device&) = delete;
+
+  device(device&& other) noexcept : hosp_(other.hosp_), hid_(other.hid_) {
+    other.hosp_ = nullptr;
+    other.hid_ = nullptr;
+  }
+
+  device& operator=(device&& other) noexcept {
+    if (this != &other) {
+      reset();
+      std::swap(hosp_, other.hosp_);
+      std::swap(hid_, other.hid_);
+    }
+    return *this;
+  }
+
+  ~device() {
+    reset();
+  }
+
+  /**
+   * Close the device, reporting failure unlike the destructor.
+   */
+  void close() {
+    int ret = hosp_ != nullptr ? ::hosp_close(hosp_) : 0;
+    hosp_ = nullptr;
+    if (hid_ != nullptr) {
+      ::hid_close(hid_);
+      hid_ = nullptr;
+    }
+    detail::check(ret, "hosp_close");
+  }
+
+  /**
+   * The underlying C handle, for functions without a wrapper.
+   */
+  hosp_device* get() const noexcept {
+    return hosp_;
+  }
+
+  hid_device* hid() const noexcept {
+    return ::hosp_get_device(hosp_);
+  }
+
+  /**
+   * Replace the underlying HID device, e.g., after a USB reset; see hosp_reopen().
+   * Without a HID device, the first HOSP device discovered is used.
+   */
+  void reopen(hid_device* dev = nullptr) {
+    detail::check(::hosp_reopen(hosp_, dev), "hosp_reopen");
+    if (hid_ != nullptr) {
+      // the handle uses a device we don't own now
+      ::hid_close(hid_);
+      hid_ = nullptr;
+    }
+  }
+
+  /**
+   * Let go of the underlying HID device once it's lost, until reopen(); see hosp_disconnect().
+   */
+  void disconnect() noexcept {
+    ::hosp_disconnect(hosp_);
+    if (hid_ != nullptr) {
+      ::hid_close(hid_);
+      hid_ = nullptr;
+    }
+  }
+
+  stats get_stats() const {
+    stats st;
+    ::hosp_get_stats(hosp_, &st);
+    return st;
+  }
+
+  void reset_stats() {
+    ::hosp_reset_stats(hosp_);
+  }
+
+  /**
+   * Get the firmware version string, e.g., "SMART POWER V3.0", resending the request up to retries times if it times
+   * out; throws ETIMEDOUT if it never arrives.
+   */
+  std::string version(std::chrono::milliseconds timeout = default_timeout, unsigned int retries = 0) {
+    char buf[17];
+    for (unsigned int i = 0; i <= retries; i++) {
+      detail::check(::hosp_request_version_write(hosp_), "hosp_request_version_write");
+      if (!detail::check(::hosp_request_version_read_timeout(hosp_, buf, sizeof(buf), detail::timeout_ms(timeout)),
+                         "hosp_request_version_read_timeout")) {
+        return std::string(buf);
+      }
+    }
+    detail::throw_timeout("hosp_request_version_read_timeout");
+  }
+
+  /**
+   * Get the ON/OFF and START/STOP state, resending the request up to retries times if it times out; throws ETIMEDOUT if
+   * it never arrives.
+   */
+  hosp::status get_status(std::chrono::milliseconds timeout = default_timeout, unsigned int retries = 0) {
+    int is_on;
+    int is_started;
+    for (unsigned int i = 0; i <= retries; i++) {
+      detail::check(::hosp_request_status_write(hosp_), "hosp_request_status_write");
+      if (!detail::check(::hosp_request_status_read_timeout(hosp_, &is_on, &is_started, detail::timeout_ms(timeout)),
+                         "hosp_request_status_read_timeout")) {
+        return hosp::status{is_on != 0, is_started != 0};
+      }
+    }
+    detail::throw_timeout("hosp_request_status_read_timeout");
+  }
+
+  void toggle_onoff() {
+    detail::check(::hosp_request_onoff_write(hosp_), "hosp_request_onoff_write");
+  }
+
+  void toggle_startstop() {
+    detail::check(::hosp_request_startstop_write(hosp_), "hosp_request_startstop_write");
+  }
+
+  /**
+   * Request a data sample and wait up to a timeout for it, timestamped when the reply was read.
+   *
+   * @return true on success, false if the timeout expired
+   */
+  bool try_read(sample& s, std::chrono::milliseconds timeout = default_timeout) {
+    return !detail::check(::hosp_snapshot(hosp_, nullptr, 0, nullptr, nullptr, &s, detail::timeout_ms(timeout)),
+                          "hosp_snapshot");
+  }
+
+  /**
+   * Read a data sample, resending the request up to retries times if it times out; throws ETIMEDOUT if it never
+   * arrives.
+   */
+  sample read(std::chrono::milliseconds timeout = default_timeout, unsigned int retries = 0) {
+    sample s;
+    for (unsigned int i = 0; i <= retries; i++) {
+      if (try_read(s, timeout)) {
+        return s;
+      }
+    }
+    detail::throw_timeout("hosp_snapshot");
+  }
+
+  /**
+   * Get a lazy range that reads a sample at the start of each interval as it's iterated, count times (0 for no limit).
+   * Samples are scheduled on absolute deadlines, so the period doesn't drift, and intervals missed by slow reads are
+   * skipped.
+   */
+  sample_range samples(std::chrono::nanoseconds interval, std::size_t count = 0,
+                       std::chrono::milliseconds timeout = default_timeout, unsigned int retries = 0);
+
+private:
+  void reset() noexcept {
+    if (hosp_ != nullptr) {
+      ::hosp_close(hosp_);
+      hosp_ = nullptr;
+    }
+    if (hid_ != nullptr) {
+      ::hid_close(hid_);
+      hid_ = nullptr;
+    }
+  }
+
+  hosp_device* hosp_;
+  // set if we opened the HID device
+  hid_device* hid_;
+};
+
+/**
+ * A single-pass range of samples read from a device, which must outlive it.
+ * The first sample is read by begin(), and each increment waits for the next interval and reads another.
+ * Read failures, including timeouts after retries, are thrown from begin() and increments.
+ */
+class sample_range {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = sample;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const sample*;
+    using reference = const sample&;
+
+    /**
+     * A copy of the sample an iterator referred to before a postfix increment read the next one, so *it++ works.
+     */
+    class proxy {
+    public:
+      reference operator*() const noexcept {
+        return value_;
+      }
+
+      pointer operator->() const noexcept {
+        return &value_;
+      }
+
+    private:
+      friend class iterator;
+      explicit proxy(const sample& value) noexcept : value_(value) {}
+      sample value_;
+    };
+
+    iterator() noexcept : range_(nullptr) {}
+
+    reference operator*() const noexcept {
+      return range_->current_;
+    }
+
+    pointer operator->() const noexcept {
+      return &range_->current_;
+    }
+
+    iterator& operator++() {
+      if (!range_->next()) {
+        range_ = nullptr;
+      }
+      return *this;
+    }
+
+    // Input iterators are single-pass, so the old value is returned by copy
+    proxy operator++(int) {
+      proxy old(range_->current_);
+      ++*this;
+      return old;
+    }
+
+    friend bool operator==(const iterator& a, const iterator& b) noexcept {
+      return a.range_ == b.range_;
+    }
+
+    friend bool operator!=(const iterator& a, const iterator& b) noexcept {
+      return a.range_ != b.range_;
+    }
+
+  private:
+    friend class sample_range;
+    explicit iterator(sample_range* range) noexcept : range_(range) {}
+    // nullptr at the end
+    sample_range* range_;
+  };
+
+  sample_range(device& dev, std::chrono::nanoseconds interval, std::size_t count, std::chrono::milliseconds timeout,
+               unsigned int retries) noexcept :
+    dev_(&dev), interval_(interval), remaining_(count), unlimited_(count == 0), timeout_(timeout), retries_(retries),
+    current_() {}
+
+  /**
+   * Start sampling with the first read.
+   */
+  iterator begin() {
+    deadline_ = std::chrono::steady_clock::now();
+    return iterator(read() ? this : nullptr);
+  }
+
+  iterator end() const noexcept {
+    return iterator();
+  }
+
+private:
+  // Returns false if there are no more samples to read
+  bool read() {
+    if (!unlimited_ && !remaining_) {
+      return false;
+    }
+    current_ = dev_->read(timeout_, retries_);
+    if (!unlimited_) {
+      remaining_--;
+    }
+    return true;
+  }
+
+  bool next() {
+    std::chrono::steady_clock::time_point now;
+    if (!unlimited_ && !remaining_) {
+      return false;
+    }
+    deadline_ += interval_;
+    now = std::chrono::steady_clock::now();
+    if (now > deadline_ && interval_.count() > 0) {
+      // skip missed intervals
+      deadline_ += ((now - deadline_) / interval_ + 1) * interval_;
+    }
+    std::this_thread::sleep_until(deadline_);
+    return read();
+  }
+
+  device* dev_;
+  std::chrono::nanoseconds interval_;
+  std::size_t remaining_;
+  bool unlimited_;
+  std::chrono::milliseconds timeout_;
+  unsigned int retries_;
+  std::chrono::steady_clock::time_point deadline_;
+  sample current_;
+};
+
+inline sample_range device::samples(std::chrono::nanoseconds interval, std::size_t count,
+                                    std::chrono::milliseconds timeout, unsigned int retries) {
+  return sample_range(*this, interval, count, timeout, retries);
+}
+
+} // namespace hosp
+
+#endif
@@ -0,0 +1,597 @@
+/**
+ * A simulated ODROID Smart Power, implementing the HIDAPI functions used by this project.
+ *
+ * The simulator emulates the device firmware's protocol and timing:
+ * - The firmware services requests one at a time, in order.
+ *   Each request completes HOSP_SIM_LATENCY_US microseconds (plus up to HOSP_SIM_JITTER_US of pseudo-random jitter)
+ *   after the later of its write and the completion of the previous request.
+ *   Until its reply is available, reads get nothing, i.e., the data is "not ready", just like with the real device.
+ * - Measurements refresh every HOSP_SIM_REFRESH_MS milliseconds (10 Hz by default), so data requests between refreshes
+ *   get the same values.
+ * - Current follows a load profile, and energy accumulates while started, wrapping after 999.999 Wh.
+ * - While off, the current, power, and energy fields read "-.---".
+ *   While stopped, the energy field reads "-.---", and starting resets it to zero.
+ * - Up to HOSP_SIM_QUEUE_LEN replies are queued for the reader, after which new replies are dropped, like when the
+ *   host's report buffer overruns.
+ * - On Linux, like HIDAPI's hidraw backend, the device handle starts with a file descriptor that's readable while a
+ *   reply is ready (a timerfd set to when the next reply is ready), so hosp_get_fd() works with the simulator too when
+ *   the library is built with HOSP_USE_SIM (when preloaded, it isn't a hidraw descriptor, so it's not supported).
+ *
+ * The simulator is configured with environment variables, which are read once, when first used:
+ *   HOSP_SIM_DEVICES     The number of devices found by hid_enumerate() (default=1)
+ *   HOSP_SIM_LATENCY_US  The time the firmware takes to service a request, in microseconds (default=1000)
+ *   HOSP_SIM_JITTER_US   The maximum additional time to service a request, in microseconds (default=0)
+ *   HOSP_SIM_SEED        The jitter pseudo-random number generator seed (default=1)
+ *   HOSP_SIM_REFRESH_MS  The measurement refresh interval in milliseconds (default=100)
+ *   HOSP_SIM_MV          The output voltage in millivolts (default=5000)
+ *   HOSP_SIM_LOAD        The load profile: constant, square, or triangle (default=constant)
+ *   HOSP_SIM_MA          The constant or minimum current in milliamps (default=500)
+ *   HOSP_SIM_PEAK_MA     The square or triangle profile's maximum current in milliamps (default=1000)
+ *   HOSP_SIM_PERIOD_MS   The square or triangle profile's period in milliseconds (default=1000)
+ *   HOSP_SIM_ON          The initial on/off state, 1 or 0 (default=1)
+ *   HOSP_SIM_STARTED     The initial start/stop state, 1 or 0 (default=1)
+ *   HOSP_SIM_UNPLUG_AT_MS  When to unplug all devices, in milliseconds after first use (default=0, never)
+ *   HOSP_SIM_UNPLUG_MS     How long devices stay unplugged, in milliseconds (default=1000)
+ *   HOSP_SIM_QUEUE_LEN     The number of replies queued for the reader, from 1 to 64 (default=64)
+ *
+ * While unplugged, devices aren't found or opened, and I/O on handles opened before they were unplugged fails with
+ * ENODEV, even after they're plugged back in, like a USB reset.
+ * Like hidraw nodes, paths stay reserved while handles opened before devices were unplugged are open, so if any are
+ * still open when devices are plugged back in, the devices get new paths, numbered after the old ones.
+ * Devices keep their serial numbers, "SIM" and their index, e.g., "SIM0".
+ *
+ * Each device open is an independent simulated device whose state is a function of the time since it was opened and
+ * the requests written to it, so runs with the same configuration and request timing get the same results.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+#include <hidapi.h>
+#include <hosp.h>
+#include "hosp-time.h"
+
+#define HOSP_SIM_REPORT_SIZE     64
+#define HOSP_SIM_QUEUE_MAX       64
+#define HOSP_SIM_PATH_PREFIX     "sim:"
+#define HOSP_SIM_SERIAL_LEN      24
+
+#define HOSP_SIM_REQUEST_DATA        0x37
+#define HOSP_SIM_REQUEST_STARTSTOP   0x80
+#define HOSP_SIM_REQUEST_STATUS      0x81
+#define HOSP_SIM_REQUEST_ONOFF       0x82
+#define HOSP_SIM_REQUEST_VERSION     0x83
+
+#define HOSP_SIM_VERSION "SMART POWER V3.0"
+
+// 1 mWh = 3600000 mW*ms
+#define HOSP_SIM_MW_MS_PER_MWH UINT64_C(3600000)
+// the energy display wraps after 999.999 Wh
+#define HOSP_SIM_MWH_WRAP 1000000
+
+typedef enum hosp_sim_load {
+  HOSP_SIM_LOAD_CONSTANT,
+  HOSP_SIM_LOAD_SQUARE,
+  HOSP_SIM_LOAD_TRIANGLE,
+} hosp_sim_load;
+
+typedef struct hosp_sim_config {
+  unsigned long devices;
+  uint64_t latency_ns;
+  uint64_t jitter_ns;
+  uint64_t seed;
+  uint64_t refresh_ms;
+  unsigned int mV;
+  hosp_sim_load load;
+  unsigned int mA;
+  unsigned int peak_mA;
+  uint64_t period_ms;
+  int is_on;
+  int is_started;
+  uint64_t start_ns;
+  uint64_t unplug_at_ns;
+  uint64_t unplug_ns;
+  size_t queue_len;
+} hosp_sim_config;
+
+typedef struct hosp_sim_reply {
+  uint64_t ready_ns;
+  unsigned char data[HOSP_SIM_REPORT_SIZE];
+} hosp_sim_reply;
+
+struct hid_device_ {
+  // must be first, for hosp_get_fd(); -1 if unsupported
+  int fd;
+  // whether the handle reserves its path, i.e., was opened before devices were unplugged
+  int is_reserving;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int is_nonblocking;
+  // firmware state
+  int is_on;
+  int is_started;
+  uint64_t open_ns;
+  uint64_t busy_ns;
+  uint64_t rng;
+  // measurement state as of the last refresh
+  uint64_t refreshes;
+  unsigned int mA;
+  unsigned int mW;
+  uint64_t energy_mW_ms;
+  // the data reply, formatted when first requested after a change
+  unsigned char frame[HOSP_SIM_REPORT_SIZE];
+  int is_frame_valid;
+  // replies not yet read
+  size_t head;
+  size_t len;
+  hosp_sim_reply queue[HOSP_SIM_QUEUE_MAX];
+};
+
+static hosp_sim_config config;
+static pthread_once_t config_once = PTHREAD_ONCE_INIT;
+
+// handles that reserve their paths, and, once devices are plugged back in, whether they got new paths
+static pthread_mutex_t paths_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long paths_reserved;
+static int is_paths_latched;
+static int is_renumbered;
+
+static uint64_t hosp_sim_getenv(const char* name, uint64_t def) {
+  const char* val = getenv(name);
+  return val == NULL || *val == '\0' ? def : strtoull(val, NULL, 0);
+}
+
+static void hosp_sim_config_init(void) {
+  const char* load = getenv("HOSP_SIM_LOAD");
+  config.devices = (unsigned long) hosp_sim_getenv("HOSP_SIM_DEVICES", 1);
+  config.latency_ns = hosp_sim_getenv("HOSP_SIM_LATENCY_US", 1000) * 1000;
+  config.jitter_ns = hosp_sim_getenv("HOSP_SIM_JITTER_US", 0) * 1000;
+  config.seed = hosp_sim_getenv("HOSP_SIM_SEED", 1);
+  config.refresh_ms = hosp_sim_getenv("HOSP_SIM_REFRESH_MS", 100);
+  config.mV = (unsigned int) hosp_sim_getenv("HOSP_SIM_MV", 5000);
+  config.mA = (unsigned int) hosp_sim_getenv("HOSP_SIM_MA", 500);
+  config.peak_mA = (unsigned int) hosp_sim_getenv("HOSP_SIM_PEAK_MA", 1000);
+  config.period_ms = hosp_sim_getenv("HOSP_SIM_PERIOD_MS", 1000);
+  config.is_on = hosp_sim_getenv("HOSP_SIM_ON", 1) != 0;
+  config.is_started = hosp_sim_getenv("HOSP_SIM_STARTED", 1) != 0;
+  config.start_ns = hosp_time_ns();
+  config.unplug_at_ns = hosp_sim_getenv("HOSP_SIM_UNPLUG_AT_MS", 0) * HOSP_NS_PER_MS;
+  config.unplug_ns = hosp_sim_getenv("HOSP_SIM_UNPLUG_MS", 1000) * HOSP_NS_PER_MS;
+  config.queue_len = (size_t) hosp_sim_getenv("HOSP_SIM_QUEUE_LEN", HOSP_SIM_QUEUE_MAX);
+  if (config.queue_len < 1 || config.queue_len > HOSP_SIM_QUEUE_MAX) {
+    config.queue_len = HOSP_SIM_QUEUE_MAX;
+  }
+  if (load == NULL || !strcmp(load, "constant")) {
+    config.load = HOSP_SIM_LOAD_CONSTANT;
+  } else if (!strcmp(load, "square")) {
+    config.load = HOSP_SIM_LOAD_SQUARE;
+  } else if (!strcmp(load, "triangle")) {
+    config.load = HOSP_SIM_LOAD_TRIANGLE;
+  } else {
+    fprintf(stderr, "hosp-sim: unknown HOSP_SIM_LOAD: %s, using constant\n", load);
+    config.load = HOSP_SIM_LOAD_CONSTANT;
+  }
+  // the fields only have room for one integer digit
+  if (config.mV > 9999) {
+    config.mV = 9999;
+  }
+  if (config.peak_mA < config.mA) {
+    config.peak_mA = config.mA;
+  }
+  if (!config.refresh_ms) {
+    config.refresh_ms = 1;
+  }
+  if (!config.period_ms) {
+    config.period_ms = 1;
+  }
+}
+
+static const hosp_sim_config* hosp_sim_get_config(void) {
+  pthread_once(&config_once, hosp_sim_config_init);
+  return &config;
+}
+
+// Returns 1 if devices are unplugged
+static int hosp_sim_is_unplugged(void) {
+  const hosp_sim_config* cfg = hosp_sim_get_config();
+  uint64_t t = hosp_time_ns() - cfg->start_ns;
+  return cfg->unplug_at_ns && t >= cfg->unplug_at_ns && t - cfg->unplug_at_ns < cfg->unplug_ns;
+}
+
+// Returns 1 if the handle was lost when devices were unplugged
+static int hosp_sim_is_lost(const hid_device* dev) {
+  const hosp_sim_config* cfg = hosp_sim_get_config();
+  uint64_t unplug_at = cfg->start_ns + cfg->unplug_at_ns;
+  return cfg->unplug_at_ns && hosp_time_ns() >= unplug_at && dev->open_ns < unplug_at + cfg->unplug_ns;
+}
+
+// Returns the first device's path number, which moves past the old paths if any were reserved when plugged back in
+static unsigned long hosp_sim_path_base(void) {
+  const hosp_sim_config* cfg = hosp_sim_get_config();
+  int renumbered;
+  pthread_mutex_lock(&paths_lock);
+  if (!is_paths_latched && cfg->unplug_at_ns && hosp_time_ns() - cfg->start_ns >= cfg->unplug_at_ns + cfg->unplug_ns) {
+    is_paths_latched = 1;
+    is_renumbered = paths_reserved > 0;
+  }
+  renumbered = is_renumbered;
+  pthread_mutex_unlock(&paths_lock);
+  return renumbered ? cfg->devices : 0;
+}
+
+// xorshift64, deterministic for a given seed
+static uint64_t hosp_sim_rand(hid_device* dev) {
+  dev->rng ^= dev->rng << 13;
+  dev->rng ^= dev->rng >> 7;
+  dev->rng ^= dev->rng << 17;
+  return dev->rng;
+}
+
+static unsigned int hosp_sim_load_mA(const hosp_sim_config* cfg, uint64_t t_ms) {
+  uint64_t phase = t_ms % cfg->period_ms;
+  uint64_t half = cfg->period_ms / 2;
+  uint64_t swing = cfg->peak_mA - cfg->mA;
+  switch (cfg->load) {
+    case HOSP_SIM_LOAD_SQUARE:
+      return phase < half ? cfg->mA : cfg->peak_mA;
+    case HOSP_SIM_LOAD_TRIANGLE:
+      if (!half) {
+        return cfg->mA;
+      }
+      return cfg->mA + (unsigned int) (phase < half ? swing * phase / half : swing * (cfg->period_ms - phase) / half);
+    case HOSP_SIM_LOAD_CONSTANT:
+    default:
+      return cfg->mA;
+  }
+}
+
+// Apply the measurement refreshes up to the given time
+static void hosp_sim_refresh(hid_device* dev, uint64_t now_ns) {
+  const hosp_sim_config* cfg = hosp_sim_get_config();
+  uint64_t target = (now_ns - dev->open_ns) / (cfg->refresh_ms * HOSP_NS_PER_MS);
+  for (; dev->refreshes < target; dev->refreshes++) {
+    dev->is_frame_valid = 0;
+    // energy accrues at the previous refresh's power for a full interval
+    if (dev->is_on && dev->is_started) {
+      dev->energy_mW_ms += (uint64_t) dev->mW * cfg->refresh_ms;
+    }
+    if (dev->is_on) {
+      dev->mA = hosp_sim_load_mA(cfg, (dev->refreshes + 1) * cfg->refresh_ms);
+      if (dev->mA > 9999) {
+        dev->mA = 9999;
+      }
+      dev->mW = cfg->mV * dev->mA / 1000;
+    } else {
+      dev->mA = 0;
+      dev->mW = 0;
+    }
+  }
+}
+
+static void hosp_sim_format_data(hid_device* dev, unsigned char* data) {
+  const hosp_sim_config* cfg = hosp_sim_get_config();
+  unsigned int mWh = (unsigned int) (dev->energy_mW_ms / HOSP_SIM_MW_MS_PER_MWH % HOSP_SIM_MWH_WRAP);
+  char buf[HOSP_SIM_REPORT_SIZE];
+  if (dev->is_frame_valid) {
+    memcpy(data, dev->frame, sizeof(dev->frame));
+    return;
+  }
+  if (!dev->is_on) {
+    snprintf(buf, sizeof(buf), "7 %u.%03uV  -.--- A -.---W  -.---Wh", cfg->mV / 1000, cfg->mV % 1000);
+  } else if (!dev->is_started) {
+    snprintf(buf, sizeof(buf), "7 %u.%03uV  %u.%03u A%2u.%03uW  -.---Wh", cfg->mV / 1000, cfg->mV % 1000,
+             dev->mA / 1000, dev->mA % 1000, dev->mW / 1000, dev->mW % 1000);
+  } else {
+    snprintf(buf, sizeof(buf), "7 %u.%03uV  %u.%03u A%2u.%03uW%3u.%03uWh", cfg->mV / 1000, cfg->mV % 1000,
+             dev->mA / 1000, dev->mA % 1000, dev->mW / 1000, dev->mW % 1000, mWh / 1000, mWh % 1000);
+  }
+  memset(dev->frame, 0, sizeof(dev->frame));
+  memcpy(dev->frame, buf, strlen(buf));
+  dev->is_frame_valid = 1;
+  memcpy(data, dev->frame, sizeof(dev->frame));
+}
+
+// Make the descriptor readable when the next reply is ready, or not readable if there isn't one
+static void hosp_sim_update_fd(hid_device* dev) {
+#if defined(__linux__)
+  struct itimerspec its;
+  uint64_t ready_ns;
+  if (dev->fd < 0) {
+    return;
+  }
+  memset(&its, 0, sizeof(its));
+  if (dev->len) {
+    // a zero time disarms the timer
+    ready_ns = dev->queue[dev->head].ready_ns ? dev->queue[dev->head].ready_ns : 1;
+    its.it_value.tv_sec = (time_t) (ready_ns / HOSP_NS_PER_S);
+    its.it_value.tv_nsec = (long) (ready_ns % HOSP_NS_PER_S);
+  }
+  // setting the timer also clears any expiration not yet read, so the descriptor isn't readable until it expires again
+  timerfd_settime(dev->fd, TFD_TIMER_ABSTIME, &its, NULL);
+#else
+  (void) dev;
+#endif
+}
+
+// Process a request in firmware order, queuing a reply if it has one
+static void hosp_sim_request(hid_device* dev, unsigned char type, uint64_t now_ns) {
+  const hosp_sim_config* cfg = hosp_sim_get_config();
+  hosp_sim_reply* reply;
+  uint64_t start_ns = dev->busy_ns > now_ns ? dev->busy_ns : now_ns;
+  unsigned char data[HOSP_SIM_REPORT_SIZE] = { 0 };
+  int has_reply = 1;
+  dev->busy_ns = start_ns + cfg->latency_ns + (cfg->jitter_ns ? hosp_sim_rand(dev) % (cfg->jitter_ns + 1) : 0);
+  hosp_sim_refresh(dev, start_ns);
+  switch (type) {
+    case HOSP_SIM_REQUEST_DATA:
+      hosp_sim_format_data(dev, data);
+      break;
+    case HOSP_SIM_REQUEST_STATUS:
+      data[0] = HOSP_SIM_REQUEST_STATUS;
+      data[1] = (unsigned char) dev->is_started;
+      data[2] = (unsigned char) dev->is_on;
+      break;
+    case HOSP_SIM_REQUEST_VERSION:
+      data[0] = HOSP_SIM_REQUEST_VERSION;
+      memcpy(&data[1], HOSP_SIM_VERSION, sizeof(HOSP_SIM_VERSION) - 1);
+      break;
+    case HOSP_SIM_REQUEST_ONOFF:
+      dev->is_on = !dev->is_on;
+      dev->is_frame_valid = 0;
+      has_reply = 0;
+      break;
+    case HOSP_SIM_REQUEST_STARTSTOP:
+      dev->is_started = !dev->is_started;
+      dev->is_frame_valid = 0;
+      if (dev->is_started) {
+        dev->energy_mW_ms = 0;
+      }
+      has_reply = 0;
+      break;
+    default:
+      // the firmware ignores unknown requests
+      has_reply = 0;
+      break;
+  }
+  if (has_reply && dev->len < cfg->queue_len) {
+    reply = &dev->queue[(dev->head + dev->len) % HOSP_SIM_QUEUE_MAX];
+    reply->ready_ns = dev->busy_ns;
+    memcpy(reply->data, data, sizeof(data));
+    if (!dev->len++) {
+      hosp_sim_update_fd(dev);
+    }
+    pthread_cond_broadcast(&dev->cond);
+  }
+}
+
+int hid_init(void) {
+  hosp_sim_get_config();
+  return 0;
+}
+
+int hid_exit(void) {
+  return 0;
+}
+
+struct hid_device_info* hid_enumerate(unsigned short vendor_id, unsigned short product_id) {
+  const hosp_sim_config* cfg = hosp_sim_get_config();
+  struct hid_device_info* head = NULL;
+  struct hid_device_info* info;
+  char path[32];
+  unsigned long base;
+  unsigned long i;
+  if ((vendor_id && vendor_id != HOSP_VENDOR_ID) || (product_id && product_id != HOSP_PRODUCT_ID) ||
+      hosp_sim_is_unplugged()) {
+    return NULL;
+  }
+  base = hosp_sim_path_base();
+  // build the list backwards so it's in path order
+  for (i = cfg->devices; i > 0; i--) {
+    snprintf(path, sizeof(path), HOSP_SIM_PATH_PREFIX"%lu", base + i - 1);
+    if ((info = calloc(1, sizeof(struct hid_device_info))) == NULL || (info->path = strdup(path)) == NULL ||
+        (info->serial_number = malloc(HOSP_SIM_SERIAL_LEN * sizeof(wchar_t))) == NULL) {
+      if (info != NULL) {
+        free(info->path);
+      }
+      free(info);
+      hid_free_enumeration(head);
+      return NULL;
+    }
+    swprintf(info->serial_number, HOSP_SIM_SERIAL_LEN, L"SIM%lu", i - 1);
+    info->vendor_id = HOSP_VENDOR_ID;
+    info->product_id = HOSP_PRODUCT_ID;
+    info->next = head;
+    head = info;
+  }
+  return head;
+}
+
+void hid_free_enumeration(struct hid_device_info* devs) {
+  struct hid_device_info* next;
+  for (; devs != NULL; devs = next) {
+    next = devs->next;
+    free(devs->path);
+    free(devs->serial_number);
+    free(devs);
+  }
+}
+
+static hid_device* hosp_sim_open(unsigned long idx) {
+  const hosp_sim_config* cfg = hosp_sim_get_config();
+  hid_device* dev;
+  if (idx >= cfg->devices || hosp_sim_is_unplugged()) {
+    errno = ENOENT;
+    return NULL;
+  }
+  if ((dev = calloc(1, sizeof(hid_device))) == NULL) {
+    return NULL;
+  }
+#if defined(__linux__)
+  dev->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#else
+  dev->fd = -1;
+#endif
+  pthread_mutex_init(&dev->lock, NULL);
+  hosp_time_cond_init(&dev->cond);
+  dev->is_on = cfg->is_on;
+  dev->is_started = cfg->is_started;
+  // xorshift state must not be zero
+  dev->rng = (cfg->seed + idx) ? cfg->seed + idx : 1;
+  dev->open_ns = hosp_time_ns();
+  dev->busy_ns = dev->open_ns;
+  if (cfg->unplug_at_ns && dev->open_ns - cfg->start_ns < cfg->unplug_at_ns) {
+    dev->is_reserving = 1;
+    pthread_mutex_lock(&paths_lock);
+    paths_reserved++;
+    pthread_mutex_unlock(&paths_lock);
+  }
+  // take the initial measurement
+  if (dev->is_on) {
+    dev->mA = hosp_sim_load_mA(cfg, 0);
+    dev->mW = cfg->mV * dev->mA / 1000;
+  }
+  return dev;
+}
+
+hid_device* hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t* serial_number) {
+  (void) serial_number;
+  if (vendor_id != HOSP_VENDOR_ID || product_id != HOSP_PRODUCT_ID) {
+    errno = ENOENT;
+    return NULL;
+  }
+  return hosp_sim_open(0);
+}
+
+hid_device* hid_open_path(const char* path) {
+  char* end;
+  unsigned long idx;
+  unsigned long base;
+  if (strncmp(path, HOSP_SIM_PATH_PREFIX, sizeof(HOSP_SIM_PATH_PREFIX) - 1)) {
+    errno = ENOENT;
+    return NULL;
+  }
+  idx = strtoul(path + sizeof(HOSP_SIM_PATH_PREFIX) - 1, &end, 10);
+  base = hosp_sim_path_base();
+  if (*end != '\0' || idx < base) {
+    errno = ENOENT;
+    return NULL;
+  }
+  return hosp_sim_open(idx - base);
+}
+
+void hid_close(hid_device* dev) {
+  if (dev->is_reserving) {
+    pthread_mutex_lock(&paths_lock);
+    paths_reserved--;
+    pthread_mutex_unlock(&paths_lock);
+  }
+#if defined(__linux__)
+  if (dev->fd >= 0) {
+    close(dev->fd);
+  }
+#endif
+  pthread_cond_destroy(&dev->cond);
+  pthread_mutex_destroy(&dev->lock);
+  free(dev);
+}
+
+int hid_set_nonblocking(hid_device* dev, int nonblock) {
+  pthread_mutex_lock(&dev->lock);
+  dev->is_nonblocking = nonblock;
+  pthread_mutex_unlock(&dev->lock);
+  return 0;
+}
+
+int hid_write(hid_device* dev, const unsigned char* data, size_t length) {
+  if (length < 2) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (hosp_sim_is_lost(dev)) {
+    errno = ENODEV;
+    return -1;
+  }
+  pthread_mutex_lock(&dev->lock);
+  // data[0] is the report ID
+  hosp_sim_request(dev, data[1], hosp_time_ns());
+  pthread_mutex_unlock(&dev->lock);
+  return (int) length;
+}
+
+// Wait for a write from another thread; returns 0, or ETIMEDOUT if the deadline passed
+static int hosp_sim_wait(hid_device* dev, int milliseconds, uint64_t deadline_ns) {
+  if (milliseconds < 0) {
+    return pthread_cond_wait(&dev->cond, &dev->lock);
+  }
+  if (hosp_time_ns() >= deadline_ns) {
+    return ETIMEDOUT;
+  }
+  return hosp_time_cond_timedwait_ns(&dev->cond, &dev->lock, deadline_ns);
+}
+
+int hid_read_timeout(hid_device* dev, unsigned char* data, size_t length, int milliseconds) {
+  hosp_sim_reply* reply;
+  uint64_t deadline = 0;
+  uint64_t now;
+  int ret = 0;
+  if (hosp_sim_is_lost(dev)) {
+    errno = ENODEV;
+    return -1;
+  }
+  if (milliseconds > 0) {
+    deadline = hosp_time_ns() + (uint64_t) milliseconds * HOSP_NS_PER_MS;
+  }
+  pthread_mutex_lock(&dev->lock);
+  for (;;) {
+    if (dev->len == 0) {
+      // nothing requested yet, so nothing will be ready until another thread writes
+      if (milliseconds == 0 || hosp_sim_wait(dev, milliseconds, deadline) == ETIMEDOUT) {
+        break;
+      }
+      continue;
+    }
+    reply = &dev->queue[dev->head];
+    now = hosp_time_ns();
+    if (reply->ready_ns <= now) {
+      length = length < HOSP_SIM_REPORT_SIZE ? length : HOSP_SIM_REPORT_SIZE;
+      memcpy(data, reply->data, length);
+      dev->head = (dev->head + 1) % HOSP_SIM_QUEUE_MAX;
+      dev->len--;
+      hosp_sim_update_fd(dev);
+      ret = (int) length;
+      break;
+    }
+    if (milliseconds == 0 || (milliseconds > 0 && now >= deadline)) {
+      // not ready
+      break;
+    }
+    // the firmware is still servicing the request
+    now = milliseconds < 0 || reply->ready_ns < deadline ? reply->ready_ns : deadline;
+    pthread_mutex_unlock(&dev->lock);
+    hosp_time_sleep_until_ns(now);
+    pthread_mutex_lock(&dev->lock);
+  }
+  pthread_mutex_unlock(&dev->lock);
+  return ret;
+}
+
+int hid_read(hid_device* dev, unsigned char* data, size_t length) {
+  int nonblock;
+  pthread_mutex_lock(&dev->lock);
+  nonblock = dev->is_nonblocking;
+  pthread_mutex_unlock(&dev->lock);
+  return hid_read_timeout(dev, data, length, nonblock ? 0 : -1);
+}
+
+const wchar_t* hid_error(hid_device* dev) {
+  (void) dev;
+  return L"Simulated device error";
+}
@@ -0,0 +1,129 @@
+/**
+ * Host-side energy integration for ODROID Smart Power data.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <hosp.h>
+#include <hosp-energy.h>
+
+// trapezoid area is (mW0 + mW1) * ns / 2 in mW*ns, and 1 uJ = 10^6 mW*ns
+#define HOSP_ENERGY_DIVISOR UINT64_C(2000000)
+// how far a wrapped counter may exceed the integrated energy, which can lag the counter's refresh and rounding
+#define HOSP_ENERGY_MWH_SLACK 10
+
+void hosp_energy_init(hosp_energy* energy) {
+  memset(energy, 0, sizeof(*energy));
+}
+
+static void hosp_energy_integrate(hosp_energy* energy, uint64_t dt_ns, unsigned int mW) {
+  uint64_t sum = (uint64_t) energy->last_mW + mW;
+  uint64_t r;
+  // split the interval so the products can't overflow for any realistic power or interval
+  energy->uJ += sum * (dt_ns / HOSP_ENERGY_DIVISOR);
+  r = sum * (dt_ns % HOSP_ENERGY_DIVISOR) + energy->rem;
+  energy->uJ += r / HOSP_ENERGY_DIVISOR;
+  energy->rem = r % HOSP_ENERGY_DIVISOR;
+}
+
+static void hosp_energy_count(hosp_energy* energy, unsigned int mWh) {
+  uint64_t delta;
+  uint64_t expected;
+  if (mWh >= energy->last_mWh) {
+    delta = mWh - energy->last_mWh;
+  } else {
+    // the counter went backwards, so either it wrapped, which the integrated energy should agree with, or it was reset
+    expected = (energy->uJ - energy->counter_uJ) / HOSP_ENERGY_UJ_PER_MWH;
+    delta = (uint64_t) HOSP_ENERGY_MWH_MAX + 1 - energy->last_mWh + mWh;
+    if (delta <= 2 * expected + HOSP_ENERGY_MWH_SLACK) {
+      energy->wraps++;
+    } else {
+      energy->resets++;
+      delta = mWh;
+    }
+  }
+  if (mWh != energy->last_mWh) {
+    energy->counter_uJ = energy->uJ;
+  }
+  energy->device_mWh += delta;
+  energy->last_mWh = mWh;
+}
+
+// Bridge a gap to the sample, reconciling the integrated energy with the device counter
+static void hosp_energy_bridge(hosp_energy* energy, const hosp_sample* sample) {
+  uint64_t start_uJ = energy->uJ;
+  uint64_t gap_uJ;
+  uint64_t delta;
+  uint64_t lo;
+  uint64_t hi = UINT64_MAX;
+  energy->is_gap = 0;
+  energy->gaps++;
+  if (sample->timestamp_ns > energy->last_ns) {
+    hosp_energy_integrate(energy, sample->timestamp_ns - energy->last_ns, sample->mW);
+    energy->last_ns = sample->timestamp_ns;
+  }
+  energy->last_mW = sample->mW;
+  if (sample->mWh >= energy->last_mWh) {
+    delta = sample->mWh - energy->last_mWh;
+    // both readings are whole mWh, so the counter is within 1 mWh either way, unless it wasn't counting at all
+    if (energy->last_mWh) {
+      hi = (delta + 1) * HOSP_ENERGY_UJ_PER_MWH;
+    }
+  } else {
+    energy->resets++;
+    delta = sample->mWh;
+  }
+  lo = delta ? (delta - 1) * HOSP_ENERGY_UJ_PER_MWH : 0;
+  gap_uJ = energy->uJ - start_uJ;
+  if (gap_uJ < lo || gap_uJ > hi) {
+    energy->uJ = start_uJ + (gap_uJ < lo ? lo : hi);
+    energy->rem = 0;
+  }
+  energy->counter_uJ = energy->uJ;
+  energy->device_mWh += delta;
+  energy->last_mWh = sample->mWh;
+}
+
+void hosp_energy_gap(hosp_energy* energy) {
+  // there's nothing to bridge from without a sample
+  energy->is_gap = energy->has_last;
+}
+
+void hosp_energy_update(hosp_energy* energy, const hosp_sample* sample) {
+  if (energy->is_gap) {
+    hosp_energy_bridge(energy, sample);
+    return;
+  }
+  if (!energy->has_last) {
+    energy->has_last = 1;
+    energy->last_ns = sample->timestamp_ns;
+    energy->last_mW = sample->mW;
+    energy->last_mWh = sample->mWh;
+    return;
+  }
+  if (sample->timestamp_ns > energy->last_ns) {
+    hosp_energy_integrate(energy, sample->timestamp_ns - energy->last_ns, sample->mW);
+    energy->last_ns = sample->timestamp_ns;
+  }
+  energy->last_mW = sample->mW;
+  hosp_energy_count(energy, sample->mWh);
+}
+
+uint64_t hosp_energy_get_uJ(const hosp_energy* energy) {
+  return energy->uJ;
+}
+
+uint64_t hosp_energy_get_device_mWh(const hosp_energy* energy) {
+  return energy->device_mWh;
+}
+
+uint64_t hosp_energy_get_wraps(const hosp_energy* energy) {
+  return energy->wraps;
+}
+
+uint64_t hosp_energy_get_resets(const hosp_energy* energy) {
+  return energy->resets;
+}
+
+uint64_t hosp_energy_get_gaps(const hosp_energy* energy) {
+  return energy->gaps;
+}
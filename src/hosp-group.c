@@ -0,0 +1,176 @@
+/**
+ * Manage a group of ODROID Smart Power devices together.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <hidapi.h>
+#include <hosp.h>
+#include <hosp-group.h>
+#include "hosp-time.h"
+
+// Per-device state is kept in parallel arrays in a single allocation after the struct
+struct hosp_group {
+  size_t n;
+  int is_own_devs;
+  hosp_device** devs;
+  hid_device** hdevs;
+  // 0, or -errno if the last write failed
+  int* errs;
+  // 1 if a request is outstanding
+  unsigned char* outstanding;
+};
+
+static hosp_group* hosp_group_alloc(size_t n) {
+  hosp_group* group;
+  unsigned char* ptr;
+  if ((ptr = calloc(1, sizeof(hosp_group) + n * (sizeof(hosp_device*) + sizeof(hid_device*) +
+                                                  sizeof(int) + sizeof(unsigned char)))) == NULL) {
+    return NULL;
+  }
+  group = (hosp_group*) (void*) ptr;
+  ptr += sizeof(hosp_group);
+  group->n = n;
+  group->devs = (hosp_device**) (void*) ptr;
+  ptr += n * sizeof(hosp_device*);
+  group->hdevs = (hid_device**) (void*) ptr;
+  ptr += n * sizeof(hid_device*);
+  group->errs = (int*) (void*) ptr;
+  ptr += n * sizeof(int);
+  group->outstanding = ptr;
+  return group;
+}
+
+hosp_group* hosp_group_open(void) {
+  struct hid_device_info* infos;
+  struct hid_device_info* info;
+  hosp_group* group;
+  size_t n = 0;
+  int err;
+  if ((infos = hosp_enumerate()) == NULL) {
+    return NULL;
+  }
+  for (info = infos; info != NULL; info = info->next) {
+    n++;
+  }
+  if ((group = hosp_group_alloc(n)) == NULL) {
+    hid_free_enumeration(infos);
+    return NULL;
+  }
+  group->is_own_devs = 1;
+  for (info = infos, n = 0; info != NULL; info = info->next, n++) {
+    errno = 0;
+    if ((group->hdevs[n] = hid_open_path(info->path)) == NULL) {
+      if (!errno) {
+        errno = EIO;
+      }
+      break;
+    }
+    if ((group->devs[n] = hosp_open_device(group->hdevs[n])) == NULL) {
+      break;
+    }
+  }
+  hid_free_enumeration(infos);
+  if (n < group->n) {
+    // clean up after the failure, preserving its errno
+    err = errno;
+    group->n = n + 1;
+    hosp_group_close(group);
+    errno = err;
+    return NULL;
+  }
+  return group;
+}
+
+hosp_group* hosp_group_create(hosp_device** devices, size_t n) {
+  hosp_group* group;
+  size_t i;
+  if (!n) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((group = hosp_group_alloc(n)) == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < n; i++) {
+    group->devs[i] = devices[i];
+  }
+  return group;
+}
+
+int hosp_group_close(hosp_group* group) {
+  size_t i;
+  int err = 0;
+  if (group->is_own_devs) {
+    for (i = 0; i < group->n; i++) {
+      if (group->devs[i] != NULL && hosp_close(group->devs[i])) {
+        err = errno;
+      }
+      if (group->hdevs[i] != NULL) {
+        hid_close(group->hdevs[i]);
+      }
+    }
+  }
+  free(group);
+  errno = err;
+  return -err;
+}
+
+size_t hosp_group_size(const hosp_group* group) {
+  return group->n;
+}
+
+hosp_device* hosp_group_get_device(hosp_group* group, size_t i) {
+  return group->devs[i];
+}
+
+int hosp_group_request_data_write(hosp_group* group) {
+  size_t i;
+  int ret = 0;
+  for (i = 0; i < group->n; i++) {
+    if (group->outstanding[i]) {
+      continue;
+    }
+    if (hosp_request_data_write(group->devs[i])) {
+      group->errs[i] = -errno;
+      ret = group->errs[i];
+    } else {
+      group->errs[i] = 0;
+      group->outstanding[i] = 1;
+    }
+  }
+  if (ret) {
+    errno = -ret;
+  }
+  return ret;
+}
+
+size_t hosp_group_request_data_read_timeout(hosp_group* group, hosp_sample* samples, int* status, int timeout_ms) {
+  uint64_t deadline = 0;
+  uint64_t now;
+  int remaining_ms = timeout_ms;
+  size_t n = 0;
+  size_t i;
+  if (timeout_ms > 0) {
+    deadline = hosp_time_ns() + (uint64_t) timeout_ms * HOSP_NS_PER_MS;
+  }
+  // requests were all sent before we started waiting, so later devices have usually replied by the time earlier ones do
+  for (i = 0; i < group->n; i++) {
+    if (!group->outstanding[i]) {
+      status[i] = group->errs[i] ? group->errs[i] : -EINVAL;
+      continue;
+    }
+    if (timeout_ms > 0) {
+      now = hosp_time_ns();
+      remaining_ms = now < deadline ? (int) ((deadline - now + HOSP_NS_PER_MS - 1) / HOSP_NS_PER_MS) : 0;
+    }
+    status[i] = hosp_request_data_read_timeout(group->devs[i], &samples[i].mV, &samples[i].mA, &samples[i].mW,
+                                               &samples[i].mWh, remaining_ms);
+    group->outstanding[i] = 0;
+    if (!status[i]) {
+      samples[i].timestamp_ns = hosp_time_ns();
+      n++;
+    }
+  }
+  return n;
+}
@@ -0,0 +1,178 @@
+/**
+ * A fixed-record binary log format for ODROID Smart Power data, with a memory-mapped reader.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <hosp.h>
+#include <hosp-log.h>
+
+struct hosp_log {
+  const unsigned char* map;
+  size_t map_len;
+  size_t num_devices;
+  size_t record_size;
+  size_t count;
+};
+
+static void hosp_log_put_u32(unsigned char* buf, uint32_t val) {
+  buf[0] = (unsigned char) val;
+  buf[1] = (unsigned char) (val >> 8);
+  buf[2] = (unsigned char) (val >> 16);
+  buf[3] = (unsigned char) (val >> 24);
+}
+
+static void hosp_log_put_u64(unsigned char* buf, uint64_t val) {
+  hosp_log_put_u32(buf, (uint32_t) val);
+  hosp_log_put_u32(buf + 4, (uint32_t) (val >> 32));
+}
+
+static uint32_t hosp_log_get_u32(const unsigned char* buf) {
+  return (uint32_t) buf[0] | (uint32_t) buf[1] << 8 | (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+static uint64_t hosp_log_get_u64(const unsigned char* buf) {
+  return (uint64_t) hosp_log_get_u32(buf) | (uint64_t) hosp_log_get_u32(buf + 4) << 32;
+}
+
+size_t hosp_log_encode_header(unsigned char* buf, uint32_t num_devices) {
+  memset(buf, 0, HOSP_LOG_HEADER_SIZE);
+  memcpy(buf, HOSP_LOG_MAGIC, sizeof(HOSP_LOG_MAGIC));
+  hosp_log_put_u32(&buf[8], HOSP_LOG_VERSION);
+  hosp_log_put_u32(&buf[12], HOSP_LOG_HEADER_SIZE);
+  hosp_log_put_u32(&buf[16], HOSP_LOG_RECORD_SIZE(num_devices));
+  hosp_log_put_u32(&buf[20], num_devices);
+  return HOSP_LOG_HEADER_SIZE;
+}
+
+size_t hosp_log_encode_record(unsigned char* buf, uint64_t timestamp_ns, const hosp_sample* samples, const int* status,
+                              size_t n) {
+  size_t i;
+  unsigned char* ptr = buf + 8;
+  hosp_log_put_u64(buf, timestamp_ns);
+  for (i = 0; i < n; i++, ptr += 16) {
+    if (status != NULL && status[i]) {
+      memset(ptr, 0xFF, 16);
+    } else {
+      hosp_log_put_u32(&ptr[0], samples[i].mV);
+      hosp_log_put_u32(&ptr[4], samples[i].mA);
+      hosp_log_put_u32(&ptr[8], samples[i].mW);
+      hosp_log_put_u32(&ptr[12], samples[i].mWh);
+    }
+  }
+  return (size_t) (ptr - buf);
+}
+
+hosp_log* hosp_log_open(const char* path) {
+  hosp_log* log;
+  struct stat st;
+  void* map;
+  uint32_t num_devices;
+  int fd;
+  int err;
+  if ((fd = open(path, O_RDONLY)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st)) {
+    err = errno;
+    close(fd);
+    errno = err;
+    return NULL;
+  }
+  if (st.st_size < HOSP_LOG_HEADER_SIZE) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  err = errno;
+  // the mapping remains valid after the descriptor is closed
+  close(fd);
+  if (map == MAP_FAILED) {
+    errno = err;
+    return NULL;
+  }
+  if ((log = calloc(1, sizeof(hosp_log))) == NULL) {
+    munmap(map, (size_t) st.st_size);
+    return NULL;
+  }
+  log->map = map;
+  log->map_len = (size_t) st.st_size;
+  // validate the header
+  num_devices = hosp_log_get_u32(&log->map[20]);
+  if (memcmp(log->map, HOSP_LOG_MAGIC, sizeof(HOSP_LOG_MAGIC)) ||
+      hosp_log_get_u32(&log->map[8]) != HOSP_LOG_VERSION ||
+      hosp_log_get_u32(&log->map[12]) != HOSP_LOG_HEADER_SIZE ||
+      num_devices == 0 ||
+      hosp_log_get_u32(&log->map[16]) != HOSP_LOG_RECORD_SIZE((uint64_t) num_devices)) {
+    hosp_log_close(log);
+    errno = EINVAL;
+    return NULL;
+  }
+  log->num_devices = num_devices;
+  log->record_size = HOSP_LOG_RECORD_SIZE(log->num_devices);
+  log->count = (log->map_len - HOSP_LOG_HEADER_SIZE) / log->record_size;
+  madvise(map, log->map_len, MADV_RANDOM);
+  return log;
+}
+
+int hosp_log_close(hosp_log* log) {
+  int ret = munmap((void*) (uintptr_t) log->map, log->map_len);
+  free(log);
+  return ret ? -errno : 0;
+}
+
+size_t hosp_log_get_num_devices(const hosp_log* log) {
+  return log->num_devices;
+}
+
+size_t hosp_log_get_count(const hosp_log* log) {
+  return log->count;
+}
+
+static const unsigned char* hosp_log_record(const hosp_log* log, size_t i) {
+  return log->map + HOSP_LOG_HEADER_SIZE + i * log->record_size;
+}
+
+uint64_t hosp_log_get_timestamp(const hosp_log* log, size_t i) {
+  return hosp_log_get_u64(hosp_log_record(log, i));
+}
+
+int hosp_log_get(const hosp_log* log, size_t i, size_t device, hosp_sample* sample) {
+  const unsigned char* rec;
+  const unsigned char* ptr;
+  if (i >= log->count || device >= log->num_devices) {
+    errno = ERANGE;
+    return -ERANGE;
+  }
+  rec = hosp_log_record(log, i);
+  ptr = rec + 8 + 16 * device;
+  sample->timestamp_ns = hosp_log_get_u64(rec);
+  sample->mV = hosp_log_get_u32(&ptr[0]);
+  sample->mA = hosp_log_get_u32(&ptr[4]);
+  sample->mW = hosp_log_get_u32(&ptr[8]);
+  sample->mWh = hosp_log_get_u32(&ptr[12]);
+  return sample->mV == HOSP_LOG_INVALID && sample->mA == HOSP_LOG_INVALID &&
+         sample->mW == HOSP_LOG_INVALID && sample->mWh == HOSP_LOG_INVALID;
+}
+
+size_t hosp_log_find(const hosp_log* log, uint64_t timestamp_ns) {
+  size_t lo = 0;
+  size_t hi = log->count;
+  size_t mid;
+  // lower bound: the first record with timestamp >= timestamp_ns
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (hosp_log_get_timestamp(log, mid) < timestamp_ns) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
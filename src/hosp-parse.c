@@ -0,0 +1,88 @@
+/**
+ * Internal reply parsers, shared by the library and its fuzz targets.
+ */
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include "hosp-parse.h"
+
+// Field shown in place of a value when the device is off, right-justified like values are
+#define HOSP_FIELD_OFF "-.---"
+#define HOSP_FIELD_OFF_LEN 5
+
+// Decode a fixed-width, right-justified decimal field with 1-3 fractional digits (e.g., " 12.345") into milliunits.
+// A field showing the device is off decodes as 0.
+// Returns 0 on success, -1 if the field is malformed
+static int hosp_decode_milliunits(const unsigned char* str, size_t len, unsigned int* val) {
+  static const unsigned int scale[4] = { 1000, 100, 10, 1 };
+  unsigned int acc = 0;
+  unsigned int nfrac = 0;
+  unsigned int seen_digit = 0;
+  unsigned int seen_dot = 0;
+  unsigned int bad = 0;
+  unsigned int d;
+  unsigned int is_digit;
+  unsigned int is_space;
+  unsigned int is_dot;
+  size_t i;
+  if (len >= HOSP_FIELD_OFF_LEN &&
+      !memcmp(&str[len - HOSP_FIELD_OFF_LEN], HOSP_FIELD_OFF, HOSP_FIELD_OFF_LEN)) {
+    // device is off, but the padding must still be valid
+    for (i = 0; i < len - HOSP_FIELD_OFF_LEN; i++) {
+      bad |= str[i] != ' ';
+    }
+    *val = 0;
+    return bad ? -1 : 0;
+  }
+  // a single pass that accumulates all digits as one integer and flags format violations instead of branching on them
+  for (i = 0; i < len; i++) {
+    d = (unsigned int) str[i] - '0';
+    is_digit = d <= 9;
+    is_space = str[i] == ' ';
+    is_dot = str[i] == '.';
+    // padding is only allowed before the value, and there must be exactly one dot, preceded by at least one digit
+    bad |= !(is_digit | is_space | is_dot);
+    bad |= is_space & (seen_digit | seen_dot);
+    bad |= is_dot & (seen_dot | !seen_digit);
+    acc = acc * (1 + 9 * is_digit) + (d & -is_digit);
+    nfrac += is_digit & seen_dot;
+    seen_digit |= is_digit;
+    seen_dot |= is_dot;
+  }
+  bad |= !seen_dot | (nfrac == 0) | (nfrac > 3);
+  if (bad) {
+    return -1;
+  }
+  *val = acc * scale[nfrac];
+  return 0;
+}
+
+int hosp_parse_data(const unsigned char* reply, unsigned int* mV, unsigned int* mA, unsigned int* mW,
+                    unsigned int* mWh) {
+  unsigned int vals[4];
+  int bad;
+  // Reply when device is off: "7 5.000V  -.--- A -.---W  -.---Wh" followed by garbage characters
+  // Dashes are replaced with actual values when device is on
+  // Volts are always shown, even when device is off
+  bad = hosp_decode_milliunits(&reply[2], 5, &vals[0]);
+  bad |= hosp_decode_milliunits(&reply[10], 5, &vals[1]);
+  bad |= hosp_decode_milliunits(&reply[17], 6, &vals[2]);
+  bad |= hosp_decode_milliunits(&reply[24], 7, &vals[3]);
+  if (bad) {
+    errno = EBADMSG;
+    return -EBADMSG;
+  }
+  if (mV != NULL) {
+    *mV = vals[0];
+  }
+  if (mA != NULL) {
+    *mA = vals[1];
+  }
+  if (mW != NULL) {
+    *mW = vals[2];
+  }
+  if (mWh != NULL) {
+    *mWh = vals[3];
+  }
+  return 0;
+}
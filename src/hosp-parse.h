@@ -0,0 +1,27 @@
+/**
+ * Internal reply parsers, shared by the library, its fuzz targets, and its tests.
+ */
+#ifndef _HOSP_PARSE_H_
+#define _HOSP_PARSE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma GCC visibility push(hidden)
+
+// A reply buffer holds a HID report and the report ID
+#define HOSP_REPLY_SIZE 65
+
+// Parse a data reply of HOSP_REPLY_SIZE bytes; output pointers may be NULL
+// Returns 0 on success, -EBADMSG if the reply is malformed (sets errno)
+int hosp_parse_data(const unsigned char* reply, unsigned int* mV, unsigned int* mA, unsigned int* mW,
+                    unsigned int* mWh);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
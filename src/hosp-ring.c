@@ -0,0 +1,66 @@
+/**
+ * Internal single-producer/multi-consumer sample ring buffer.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <hosp.h>
+#include "hosp-ring.h"
+
+static void hosp_ring_slot_store(hosp_ring_slot* slot, uint64_t seq, const hosp_sample* s) {
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&slot->sample.timestamp_ns, s->timestamp_ns, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->sample.mV, s->mV, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->sample.mA, s->mA, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->sample.mW, s->mW, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->sample.mWh, s->mWh, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+// Returns 1 if the slot held the sample with sequence number seq for the duration of the copy, 0 otherwise
+static int hosp_ring_slot_load(const hosp_ring_slot* slot, uint64_t seq, hosp_sample* s) {
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq + 1) {
+    return 0;
+  }
+  s->timestamp_ns = __atomic_load_n(&slot->sample.timestamp_ns, __ATOMIC_RELAXED);
+  s->mV = __atomic_load_n(&slot->sample.mV, __ATOMIC_RELAXED);
+  s->mA = __atomic_load_n(&slot->sample.mA, __ATOMIC_RELAXED);
+  s->mW = __atomic_load_n(&slot->sample.mW, __ATOMIC_RELAXED);
+  s->mWh = __atomic_load_n(&slot->sample.mWh, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq + 1;
+}
+
+void hosp_ring_push(hosp_ring_slot* slots, size_t capacity, uint64_t* head, const hosp_sample* sample) {
+  uint64_t h = __atomic_load_n(head, __ATOMIC_RELAXED);
+  hosp_ring_slot_store(&slots[h % capacity], h, sample);
+  __atomic_store_n(head, h + 1, __ATOMIC_RELEASE);
+}
+
+size_t hosp_ring_read(const hosp_ring_slot* slots, size_t capacity, const uint64_t* head, uint64_t* cursor,
+                      hosp_sample* samples, size_t len) {
+  size_t n = 0;
+  uint64_t h = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+  if (*cursor > h) {
+    *cursor = h;
+  }
+  while (n < len && *cursor < h) {
+    if (h - *cursor > capacity) {
+      // fell behind, skip to the oldest sample still in the ring
+      *cursor = h - capacity;
+    }
+    if (hosp_ring_slot_load(&slots[*cursor % capacity], *cursor, &samples[n])) {
+      n++;
+      (*cursor)++;
+    } else {
+      // the producer lapped us and is overwriting the slot, so skip past the slot it's writing (at head) and retry
+      h = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+      if (h - capacity + 1 > *cursor + 1) {
+        *cursor = h - capacity + 1;
+      } else {
+        (*cursor)++;
+      }
+    }
+  }
+  return n;
+}
@@ -0,0 +1,41 @@
+/**
+ * Internal single-producer/multi-consumer sample ring buffer, shared by the sampler and shared memory.
+ *
+ * Each slot has a sequence number, seqlock style: the producer invalidates a slot before overwriting it and publishes
+ * the new sequence number afterward, so a consumer knows its copy is consistent if it sees the expected sequence number
+ * both before and after reading the slot.
+ * The ring only uses lock-free atomics on memory it's given, so it works in process-shared memory too.
+ */
+#ifndef _HOSP_RING_H_
+#define _HOSP_RING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hosp.h>
+
+#pragma GCC visibility push(hidden)
+
+typedef struct hosp_ring_slot {
+  // sequence number + 1 of the sample in the slot, 0 while the slot is being written
+  uint64_t seq;
+  hosp_sample sample;
+} hosp_ring_slot;
+
+// Write a sample to the ring and advance the head (the sequence number of the next sample), for the single producer
+void hosp_ring_push(hosp_ring_slot* slots, size_t capacity, uint64_t* head, const hosp_sample* sample);
+
+// Read up to len samples starting at the cursor, which is advanced (see hosp_sampler_read)
+size_t hosp_ring_read(const hosp_ring_slot* slots, size_t capacity, const uint64_t* head, uint64_t* cursor,
+                      hosp_sample* samples, size_t len);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
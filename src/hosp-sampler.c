@@ -0,0 +1,212 @@
+/**
+ * A background sampler for an ODROID Smart Power device.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <hosp.h>
+#include <hosp-energy.h>
+#include <hosp-sampler.h>
+#include "hosp-ring.h"
+#include "hosp-time.h"
+
+// Wait for up to 1/4 second for a response
+#define HOSP_SAMPLER_READ_TIMEOUT_MS 250
+
+struct hosp_sampler {
+  hosp_device* hosp;
+  pthread_t thread;
+  uint64_t interval_ns;
+  size_t capacity;
+  hosp_ring_slot* slots;
+  // sequence number of the next sample to write
+  uint64_t head;
+  int running;
+  // cumulative energy, only used by the sampler thread
+  hosp_energy energy;
+  // seqlock for the latest sample's state, for regions: odd while it's being written, 0 until the first sample
+  uint64_t latest_lock;
+  uint64_t latest_seq;
+  uint64_t latest_ns;
+  uint64_t latest_uJ;
+  unsigned int latest_mW;
+};
+
+static void hosp_sampler_publish_latest(hosp_sampler* sampler, uint64_t seq, const hosp_sample* s) {
+  uint64_t lock = __atomic_load_n(&sampler->latest_lock, __ATOMIC_RELAXED);
+  __atomic_store_n(&sampler->latest_lock, lock + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&sampler->latest_seq, seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&sampler->latest_ns, s->timestamp_ns, __ATOMIC_RELAXED);
+  __atomic_store_n(&sampler->latest_uJ, hosp_energy_get_uJ(&sampler->energy), __ATOMIC_RELAXED);
+  __atomic_store_n(&sampler->latest_mW, s->mW, __ATOMIC_RELAXED);
+  __atomic_store_n(&sampler->latest_lock, lock + 2, __ATOMIC_RELEASE);
+}
+
+// Returns 0 on success, -errno on failure
+static int hosp_sampler_get_data(hosp_sampler* sampler, hosp_sample* s) {
+  int ret;
+  if (hosp_request_data_write(sampler->hosp)) {
+    return -errno;
+  }
+  if ((ret = hosp_request_data_read_timeout(sampler->hosp, &s->mV, &s->mA, &s->mW, &s->mWh,
+                                            HOSP_SAMPLER_READ_TIMEOUT_MS)) < 0) {
+    return ret;
+  } else if (ret) {
+    return -ENODATA;
+  }
+  s->timestamp_ns = hosp_time_ns();
+  return 0;
+}
+
+static void* hosp_sampler_run(void* arg) {
+  hosp_sampler* sampler = (hosp_sampler*) arg;
+  hosp_sample s;
+  uint64_t deadline = hosp_time_ns();
+  while (__atomic_load_n(&sampler->running, __ATOMIC_ACQUIRE)) {
+    if (!hosp_sampler_get_data(sampler, &s)) {
+      hosp_energy_update(&sampler->energy, &s);
+      hosp_ring_push(sampler->slots, sampler->capacity, &sampler->head, &s);
+      // publish after the ring, so a region that begins at this sample can find the next one there
+      hosp_sampler_publish_latest(sampler, __atomic_load_n(&sampler->head, __ATOMIC_RELAXED) - 1, &s);
+    }
+    deadline = hosp_time_sleep_period_ns(deadline, sampler->interval_ns);
+  }
+  return NULL;
+}
+
+hosp_sampler* hosp_sampler_start(hosp_device* hosp, unsigned long interval_ms, size_t capacity) {
+  hosp_sampler* sampler;
+  int ret;
+  if (!interval_ms || !capacity) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((sampler = calloc(1, sizeof(hosp_sampler))) == NULL) {
+    return NULL;
+  }
+  if ((sampler->slots = calloc(capacity, sizeof(hosp_ring_slot))) == NULL) {
+    free(sampler);
+    return NULL;
+  }
+  sampler->hosp = hosp;
+  sampler->interval_ns = interval_ms * HOSP_NS_PER_MS;
+  sampler->capacity = capacity;
+  sampler->running = 1;
+  hosp_energy_init(&sampler->energy);
+  if ((ret = pthread_create(&sampler->thread, NULL, hosp_sampler_run, sampler))) {
+    free(sampler->slots);
+    free(sampler);
+    errno = ret;
+    return NULL;
+  }
+  return sampler;
+}
+
+int hosp_sampler_stop(hosp_sampler* sampler) {
+  int ret;
+  __atomic_store_n(&sampler->running, 0, __ATOMIC_RELEASE);
+  ret = pthread_join(sampler->thread, NULL);
+  free(sampler->slots);
+  free(sampler);
+  if (ret) {
+    errno = ret;
+    return -ret;
+  }
+  return 0;
+}
+
+uint64_t hosp_sampler_get_seq(const hosp_sampler* sampler) {
+  return __atomic_load_n(&sampler->head, __ATOMIC_ACQUIRE);
+}
+
+size_t hosp_sampler_read(hosp_sampler* sampler, uint64_t* cursor, hosp_sample* samples, size_t len) {
+  return hosp_ring_read(sampler->slots, sampler->capacity, &sampler->head, cursor, samples, len);
+}
+
+// Returns 0 on success, -ENODATA if there's no sample yet
+static int hosp_sampler_get_latest(const hosp_sampler* sampler, hosp_region* r) {
+  uint64_t lock;
+  do {
+    if ((lock = __atomic_load_n(&sampler->latest_lock, __ATOMIC_ACQUIRE)) == 0) {
+      return -ENODATA;
+    }
+    if (lock & 1) {
+      // a write is in progress
+      continue;
+    }
+    r->seq = __atomic_load_n(&sampler->latest_seq, __ATOMIC_RELAXED);
+    r->sample_ns = __atomic_load_n(&sampler->latest_ns, __ATOMIC_RELAXED);
+    r->uJ = __atomic_load_n(&sampler->latest_uJ, __ATOMIC_RELAXED);
+    r->mW = __atomic_load_n(&sampler->latest_mW, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((lock & 1) || __atomic_load_n(&sampler->latest_lock, __ATOMIC_RELAXED) != lock);
+  return 0;
+}
+
+// Cumulative energy in uJ at time t, extrapolated from the sample in r by holding its power
+static double hosp_region_extrapolate(const hosp_region* r, uint64_t t) {
+  return (double) r->uJ + (double) r->mW * (double) (int64_t) (t - r->sample_ns) / 1000000.0;
+}
+
+// Cumulative energy in uJ at time t, interpolated between the sample in r and the next sample s, if available
+static double hosp_region_interpolate(const hosp_sampler* sampler, const hosp_region* r, uint64_t t) {
+  hosp_region next;
+  hosp_sample s;
+  uint64_t cursor = r->seq + 1;
+  double dt;
+  double span;
+  double mW;
+  if (hosp_ring_read(sampler->slots, sampler->capacity, &sampler->head, &cursor, &s, 1) != 1 ||
+      cursor != r->seq + 2 || s.timestamp_ns <= r->sample_ns) {
+    // the next sample isn't available, either because it's not collected yet or was overwritten
+    return hosp_region_extrapolate(r, t);
+  }
+  span = (double) (s.timestamp_ns - r->sample_ns);
+  if (t >= s.timestamp_ns) {
+    // the sampler's trapezoidal integration from the region's sample to the next
+    next.seq = r->seq + 1;
+    next.sample_ns = s.timestamp_ns;
+    next.uJ = r->uJ + (uint64_t) (((double) r->mW + (double) s.mW) * span / 2000000.0);
+    next.mW = s.mW;
+    return hosp_region_extrapolate(&next, t);
+  }
+  if (t <= r->sample_ns) {
+    return hosp_region_extrapolate(r, t);
+  }
+  // integrate power linearly interpolated between the samples
+  dt = (double) (t - r->sample_ns);
+  mW = (double) r->mW + ((double) s.mW - (double) r->mW) * dt / span;
+  return (double) r->uJ + ((double) r->mW + mW) * dt / 2000000.0;
+}
+
+int hosp_region_begin(const hosp_sampler* sampler, hosp_region* region) {
+  int ret;
+  region->start_ns = hosp_time_ns();
+  if ((ret = hosp_sampler_get_latest(sampler, region))) {
+    errno = -ret;
+  }
+  return ret;
+}
+
+int hosp_region_end(const hosp_sampler* sampler, const hosp_region* region, uint64_t* uJ, uint64_t* duration_ns,
+                    unsigned int* mW) {
+  hosp_region end;
+  uint64_t end_ns = hosp_time_ns();
+  double uJ_begin;
+  double uJ_end;
+  int ret;
+  // the sample after the region began is likely still in the ring, but the one after it ends isn't collected yet
+  uJ_begin = hosp_region_interpolate(sampler, region, region->start_ns);
+  // get the end state after, so it can't be older than a sample used for the beginning
+  if ((ret = hosp_sampler_get_latest(sampler, &end))) {
+    errno = -ret;
+    return ret;
+  }
+  uJ_end = end.seq == region->seq ? hosp_region_extrapolate(region, end_ns) : hosp_region_extrapolate(&end, end_ns);
+  *uJ = uJ_end > uJ_begin ? (uint64_t) (uJ_end - uJ_begin + 0.5) : 0;
+  *duration_ns = end_ns - region->start_ns;
+  *mW = *duration_ns ? (unsigned int) (*uJ * 1000000 / *duration_ns) : region->mW;
+  return 0;
+}
@@ -0,0 +1,254 @@
+/**
+ * Publish ODROID Smart Power samples to local processes through POSIX shared memory.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <hosp.h>
+#include <hosp-shm.h>
+#include "hosp-ring.h"
+#include "hosp-time.h"
+
+#define HOSP_SHM_MAGIC "HOSPSHM"
+// the ring starts on its own cache line
+#define HOSP_SHM_RING_OFFSET 128
+// readers give up on the latest sample if a write appears to be in progress for this many tries, e.g., the writer died
+#define HOSP_SHM_READ_TRIES 1000
+
+struct hosp_shm_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t ring_offset;
+  uint64_t capacity;
+  uint64_t interval_ns;
+  // the writer's process ID, to detect stale segments
+  uint64_t pid;
+  // seqlock for the latest sample: odd while it's being written, 0 until the first sample
+  uint64_t latest_seq;
+  hosp_sample latest;
+  // sequence number of the next sample in the ring
+  uint64_t head;
+};
+
+struct hosp_shm {
+  struct hosp_shm_header* hdr;
+  hosp_ring_slot* slots;
+  size_t capacity;
+  size_t map_len;
+  // the writer removes the name when it closes
+  char* name;
+};
+
+static hosp_shm* hosp_shm_map(int fd, size_t len, int prot) {
+  hosp_shm* shm;
+  void* map;
+  int err;
+  if ((shm = calloc(1, sizeof(hosp_shm))) == NULL) {
+    return NULL;
+  }
+  if ((map = mmap(NULL, len, prot, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    err = errno;
+    free(shm);
+    errno = err;
+    return NULL;
+  }
+  shm->hdr = map;
+  shm->slots = (hosp_ring_slot*) (void*) ((unsigned char*) map + HOSP_SHM_RING_OFFSET);
+  shm->map_len = len;
+  return shm;
+}
+
+hosp_shm* hosp_shm_open(const char* name) {
+  hosp_shm* shm;
+  struct stat st;
+  uint64_t capacity;
+  int fd;
+  int err;
+  if ((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st)) {
+    err = errno;
+    close(fd);
+    errno = err;
+    return NULL;
+  }
+  if (st.st_size < HOSP_SHM_RING_OFFSET) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  shm = hosp_shm_map(fd, (size_t) st.st_size, PROT_READ);
+  err = errno;
+  // the mapping remains valid after the descriptor is closed
+  close(fd);
+  if (shm == NULL) {
+    errno = err;
+    return NULL;
+  }
+  // validate the header; the writer sets the magic last
+  capacity = shm->hdr->capacity;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (memcmp(shm->hdr->magic, HOSP_SHM_MAGIC, sizeof(HOSP_SHM_MAGIC)) ||
+      shm->hdr->version != HOSP_SHM_VERSION ||
+      shm->hdr->ring_offset != HOSP_SHM_RING_OFFSET ||
+      capacity == 0 ||
+      capacity > (shm->map_len - HOSP_SHM_RING_OFFSET) / sizeof(hosp_ring_slot)) {
+    hosp_shm_close(shm);
+    errno = EINVAL;
+    return NULL;
+  }
+  shm->capacity = (size_t) capacity;
+  return shm;
+}
+
+// Returns 1 if the named segment was left behind by a writer that no longer exists, including a segment that doesn't
+// validate, e.g., its header was truncated or zeroed, unless it names a writer that's still running
+static int hosp_shm_is_stale(const char* name) {
+  struct hosp_shm_header* hdr;
+  struct stat st;
+  uint64_t pid = 0;
+  int fd;
+  if ((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+    // if it's gone, there's nothing in the way
+    return errno == ENOENT;
+  }
+  if (fstat(fd, &st)) {
+    close(fd);
+    return 0;
+  }
+  // a segment too short to name its writer has none to wait for
+  if ((size_t) st.st_size >= sizeof(struct hosp_shm_header)) {
+    hdr = mmap(NULL, sizeof(struct hosp_shm_header), PROT_READ, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+      close(fd);
+      return 0;
+    }
+    pid = hdr->pid;
+    munmap(hdr, sizeof(struct hosp_shm_header));
+  }
+  close(fd);
+  // a PID that doesn't fit can't be a running process (and mustn't be passed to kill() as a process group)
+  return pid == 0 || pid > INT_MAX || (kill((pid_t) pid, 0) && errno == ESRCH);
+}
+
+hosp_shm* hosp_shm_create(const char* name, size_t capacity, unsigned long interval_ms) {
+  hosp_shm* shm;
+  size_t len;
+  int fd;
+  int err;
+  if (!capacity || capacity > (SIZE_MAX - HOSP_SHM_RING_OFFSET) / sizeof(hosp_ring_slot)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  len = HOSP_SHM_RING_OFFSET + capacity * sizeof(hosp_ring_slot);
+  if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0 && errno == EEXIST) {
+    if (!hosp_shm_is_stale(name)) {
+      errno = EBUSY;
+      return NULL;
+    }
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  }
+  if (fd < 0) {
+    return NULL;
+  }
+  // the new segment is zero-filled, i.e., it has no samples yet
+  if (ftruncate(fd, (off_t) len) || (shm = hosp_shm_map(fd, len, PROT_READ | PROT_WRITE)) == NULL) {
+    err = errno;
+    close(fd);
+    shm_unlink(name);
+    errno = err;
+    return NULL;
+  }
+  close(fd);
+  if ((shm->name = strdup(name)) == NULL) {
+    err = errno;
+    hosp_shm_close(shm);
+    shm_unlink(name);
+    errno = err;
+    return NULL;
+  }
+  shm->capacity = capacity;
+  shm->hdr->version = HOSP_SHM_VERSION;
+  shm->hdr->ring_offset = HOSP_SHM_RING_OFFSET;
+  shm->hdr->capacity = capacity;
+  shm->hdr->interval_ns = interval_ms * HOSP_NS_PER_MS;
+  shm->hdr->pid = (uint64_t) getpid();
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(shm->hdr->magic, HOSP_SHM_MAGIC, sizeof(HOSP_SHM_MAGIC));
+  return shm;
+}
+
+int hosp_shm_close(hosp_shm* shm) {
+  int err = 0;
+  if (munmap(shm->hdr, shm->map_len)) {
+    err = errno;
+  }
+  if (shm->name != NULL && shm_unlink(shm->name)) {
+    err = errno;
+  }
+  free(shm->name);
+  free(shm);
+  errno = err;
+  return -err;
+}
+
+void hosp_shm_publish(hosp_shm* shm, const hosp_sample* sample) {
+  struct hosp_shm_header* hdr = shm->hdr;
+  uint64_t seq = __atomic_load_n(&hdr->latest_seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&hdr->latest_seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&hdr->latest.timestamp_ns, sample->timestamp_ns, __ATOMIC_RELAXED);
+  __atomic_store_n(&hdr->latest.mV, sample->mV, __ATOMIC_RELAXED);
+  __atomic_store_n(&hdr->latest.mA, sample->mA, __ATOMIC_RELAXED);
+  __atomic_store_n(&hdr->latest.mW, sample->mW, __ATOMIC_RELAXED);
+  __atomic_store_n(&hdr->latest.mWh, sample->mWh, __ATOMIC_RELAXED);
+  __atomic_store_n(&hdr->latest_seq, seq + 2, __ATOMIC_RELEASE);
+  hosp_ring_push(shm->slots, shm->capacity, &hdr->head, sample);
+}
+
+int hosp_shm_get_latest(const hosp_shm* shm, hosp_sample* sample) {
+  const struct hosp_shm_header* hdr = shm->hdr;
+  uint64_t seq;
+  unsigned int i;
+  for (i = 0; i < HOSP_SHM_READ_TRIES; i++) {
+    if ((seq = __atomic_load_n(&hdr->latest_seq, __ATOMIC_ACQUIRE)) == 0) {
+      return 1;
+    }
+    if (seq & 1) {
+      // a write is in progress
+      continue;
+    }
+    sample->timestamp_ns = __atomic_load_n(&hdr->latest.timestamp_ns, __ATOMIC_RELAXED);
+    sample->mV = __atomic_load_n(&hdr->latest.mV, __ATOMIC_RELAXED);
+    sample->mA = __atomic_load_n(&hdr->latest.mA, __ATOMIC_RELAXED);
+    sample->mW = __atomic_load_n(&hdr->latest.mW, __ATOMIC_RELAXED);
+    sample->mWh = __atomic_load_n(&hdr->latest.mWh, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&hdr->latest_seq, __ATOMIC_RELAXED) == seq) {
+      return 0;
+    }
+  }
+  errno = EAGAIN;
+  return -EAGAIN;
+}
+
+uint64_t hosp_shm_get_seq(const hosp_shm* shm) {
+  return __atomic_load_n(&shm->hdr->head, __ATOMIC_ACQUIRE);
+}
+
+unsigned long hosp_shm_get_interval_ms(const hosp_shm* shm) {
+  return (unsigned long) (shm->hdr->interval_ns / HOSP_NS_PER_MS);
+}
+
+size_t hosp_shm_read(const hosp_shm* shm, uint64_t* cursor, hosp_sample* samples, size_t len) {
+  return hosp_ring_read(shm->slots, shm->capacity, &shm->hdr->head, cursor, samples, len);
+}
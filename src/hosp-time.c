@@ -0,0 +1,93 @@
+/**
+ * Internal monotonic clock functions.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "hosp-time.h"
+
+// Whether condition variables can use the monotonic clock (POSIX clock selection), which macOS doesn't support
+#if defined(_POSIX_CLOCK_SELECTION)
+#if _POSIX_CLOCK_SELECTION >= 0
+#define HOSP_TIME_COND_MONOTONIC
+#endif
+#endif
+
+uint64_t hosp_time_ns(void) {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return 0;
+  }
+  return (uint64_t) ts.tv_sec * HOSP_NS_PER_S + (uint64_t) ts.tv_nsec;
+}
+
+int hosp_time_sleep_until_ns(uint64_t deadline_ns) {
+  struct timespec ts;
+#if defined(__linux__)
+  int ret;
+  ts.tv_sec = (time_t) (deadline_ns / HOSP_NS_PER_S);
+  ts.tv_nsec = (long) (deadline_ns % HOSP_NS_PER_S);
+  while ((ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR);
+  return ret;
+#else
+  // no absolute sleep available (e.g., macOS), so fall back on a relative one
+  uint64_t now = hosp_time_ns();
+  if (deadline_ns <= now) {
+    return 0;
+  }
+  ts.tv_sec = (time_t) ((deadline_ns - now) / HOSP_NS_PER_S);
+  ts.tv_nsec = (long) ((deadline_ns - now) % HOSP_NS_PER_S);
+  return nanosleep(&ts, NULL) ? errno : 0;
+#endif
+}
+
+uint64_t hosp_time_sleep_period_ns(uint64_t deadline_ns, uint64_t interval_ns) {
+  uint64_t now;
+  deadline_ns += interval_ns;
+  if ((now = hosp_time_ns()) > deadline_ns) {
+    deadline_ns += ((now - deadline_ns) / interval_ns + 1) * interval_ns;
+  }
+  hosp_time_sleep_until_ns(deadline_ns);
+  return deadline_ns;
+}
+
+#ifdef HOSP_TIME_COND_MONOTONIC
+// shared by all condition variables, and never destroyed
+static pthread_condattr_t cond_attr;
+static pthread_once_t cond_attr_once = PTHREAD_ONCE_INIT;
+static int cond_attr_err;
+
+static void hosp_time_cond_attr_init(void) {
+  if (!(cond_attr_err = pthread_condattr_init(&cond_attr))) {
+    cond_attr_err = pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  }
+}
+#endif
+
+int hosp_time_cond_init(pthread_cond_t* cond) {
+#ifdef HOSP_TIME_COND_MONOTONIC
+  pthread_once(&cond_attr_once, hosp_time_cond_attr_init);
+  return cond_attr_err ? cond_attr_err : pthread_cond_init(cond, &cond_attr);
+#else
+  return pthread_cond_init(cond, NULL);
+#endif
+}
+
+int hosp_time_cond_timedwait_ns(pthread_cond_t* cond, pthread_mutex_t* mutex, uint64_t deadline_ns) {
+  struct timespec ts;
+#ifdef HOSP_TIME_COND_MONOTONIC
+  ts.tv_sec = (time_t) (deadline_ns / HOSP_NS_PER_S);
+  ts.tv_nsec = (long) (deadline_ns % HOSP_NS_PER_S);
+#else
+  // the condition variable uses the realtime clock, so convert the time remaining
+  uint64_t now = hosp_time_ns();
+  uint64_t ns;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ns = (uint64_t) ts.tv_nsec + (deadline_ns > now ? deadline_ns - now : 0);
+  ts.tv_sec += (time_t) (ns / HOSP_NS_PER_S);
+  ts.tv_nsec = (long) (ns % HOSP_NS_PER_S);
+#endif
+  return pthread_cond_timedwait(cond, mutex, &ts);
+}
@@ -0,0 +1,46 @@
+/**
+ * Internal monotonic clock functions.
+ *
+ * Condition variables use the realtime clock by default, so timed waits jump when the system time is set.
+ * hosp_time_cond_init() makes them use the monotonic clock instead where that's supported, and
+ * hosp_time_cond_timedwait_ns() takes a monotonic deadline either way, converting it where it isn't (e.g., macOS).
+ */
+#ifndef _HOSP_TIME_H_
+#define _HOSP_TIME_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+
+#pragma GCC visibility push(hidden)
+
+#define HOSP_NS_PER_MS UINT64_C(1000000)
+#define HOSP_NS_PER_S  UINT64_C(1000000000)
+
+// Returns the CLOCK_MONOTONIC time in nanoseconds, or 0 on failure
+uint64_t hosp_time_ns(void);
+
+// Sleep until the absolute CLOCK_MONOTONIC time, returns 0 on success or an errno value on failure
+int hosp_time_sleep_until_ns(uint64_t deadline_ns);
+
+// Advance a periodic CLOCK_MONOTONIC deadline by an interval (> 0) and sleep until it, skipping to the next period
+// boundary if it already passed rather than bursting to catch up; returns the new deadline
+uint64_t hosp_time_sleep_period_ns(uint64_t deadline_ns, uint64_t interval_ns);
+
+// Initialize a condition variable for hosp_time_cond_timedwait_ns(); returns 0 on success or an errno value on failure
+int hosp_time_cond_init(pthread_cond_t* cond);
+
+// Wait on a condition variable from hosp_time_cond_init() until the absolute CLOCK_MONOTONIC time; returns like
+// pthread_cond_timedwait(), i.e., 0 if woken (perhaps spuriously), or ETIMEDOUT
+int hosp_time_cond_timedwait_ns(pthread_cond_t* cond, pthread_mutex_t* mutex, uint64_t deadline_ns);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,13 +5,21 @@
  * @date 2018-05-22
  */
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(HOSP_HIDRAW) && !defined(HOSP_SIM)
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+#endif
 #include <hidapi.h>
 #include <hosp.h>
+#include "hosp-parse.h"
+#include "hosp-time.h"
 
-#define HOSP_BUF_SIZE            65
+#define HOSP_BUF_SIZE            HOSP_REPLY_SIZE
 #define HOSP_REQUEST_DATA        0x37
 #define HOSP_REQUEST_STARTSTOP   0x80
 #define HOSP_REQUEST_STATUS      0x81
@@ -25,21 +33,114 @@
   #define HOSP_DEBUG 0
 #endif
 
+// Requests that get replies each track their own write time, pending requests, and mailbox
+#define HOSP_REPLY_TYPES         3
+
+// Replies each mailbox holds for other callers, e.g., several threads or pipelined asynchronous requests of one type
+#define HOSP_MAILBOX_LEN         HOSP_ASYNC_MAX_PENDING
+
+// In place of a timeout, make one hid_read() attempt, which blocks or not as set by hid_set_nonblocking()
+#define HOSP_READ_ONCE           INT_MIN
+
 struct hosp_device {
   hid_device* dev;
-  unsigned char buf[HOSP_BUF_SIZE];
   int is_own_dev;
+  // statistics are updated atomically so they can be queried while another thread uses the device
+  hosp_stats stats;
+  uint64_t write_ns[HOSP_REPLY_TYPES];
+  // Replies are routed to callers by type, so threads can share the device: one thread at a time reads from the device
+  // (the leader) while others wait, and it leaves replies for other callers in their type's mailbox
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int is_reading;
+  unsigned int followers;
+  // requests of each type written and not yet answered or forgotten; replies without one are stale and discarded
+  unsigned int pending[HOSP_REPLY_TYPES];
+  // how many of the oldest pending requests of each type were abandoned, e.g., timed out, so their replies, which are
+  // still coming, are discarded rather than answering newer requests
+  unsigned int stale[HOSP_REPLY_TYPES];
+  // a bitmask of reply types with replies in their mailbox, which are queues
+  unsigned int mail;
+  unsigned char mailbox[HOSP_REPLY_TYPES][HOSP_MAILBOX_LEN][HOSP_BUF_SIZE];
+  size_t mail_head[HOSP_REPLY_TYPES];
+  size_t mail_len[HOSP_REPLY_TYPES];
+  // request types of pending asynchronous requests, in order
+  unsigned char async_types[HOSP_ASYNC_MAX_PENDING];
+  size_t async_head;
+  size_t async_len;
+  // the version never changes, so it's only requested once
+  char version[17];
+  int has_version;
 };
 
+// Returns the index of a request type that gets a reply, or HOSP_REPLY_TYPES if it doesn't get one
+static unsigned int hosp_reply_index(unsigned char type) {
+  switch (type) {
+    case HOSP_REQUEST_DATA:
+      return 0;
+    case HOSP_REQUEST_STATUS:
+      return 1;
+    case HOSP_REQUEST_VERSION:
+      return 2;
+    default:
+      return HOSP_REPLY_TYPES;
+  }
+}
+
+static void hosp_stats_inc(uint64_t* counter) {
+  __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+static void hosp_stats_write(hosp_device* hosp, unsigned char type, int ret) {
+  unsigned int idx = hosp_reply_index(type);
+  if (ret) {
+    hosp_stats_inc(&hosp->stats.write_errors);
+  } else {
+    hosp_stats_inc(&hosp->stats.writes);
+    if (idx < HOSP_REPLY_TYPES) {
+      __atomic_store_n(&hosp->write_ns[idx], hosp_time_ns(), __ATOMIC_RELAXED);
+    }
+  }
+}
+
+static void hosp_stats_read(hosp_device* hosp, unsigned char type, int ret) {
+  unsigned int idx = hosp_reply_index(type);
+  uint64_t write_ns;
+  uint64_t us;
+  unsigned int bucket = 0;
+  if (ret < 0) {
+    hosp_stats_inc(&hosp->stats.read_errors);
+  } else if (ret > 0) {
+    hosp_stats_inc(&hosp->stats.reads_not_ready);
+  } else {
+    hosp_stats_inc(&hosp->stats.reads);
+    if (idx < HOSP_REPLY_TYPES && (write_ns = __atomic_load_n(&hosp->write_ns[idx], __ATOMIC_RELAXED))) {
+      // bucket 0 is [0, 1) us, bucket i > 0 is [2^(i-1), 2^i) us, and the last bucket includes everything longer
+      if ((us = (hosp_time_ns() - write_ns) / 1000) > 0) {
+        bucket = 64 - (unsigned int) __builtin_clzll(us);
+        if (bucket >= HOSP_STATS_LATENCY_BUCKETS) {
+          bucket = HOSP_STATS_LATENCY_BUCKETS - 1;
+        }
+      }
+      hosp_stats_inc(&hosp->stats.latency[bucket]);
+    }
+  }
+}
+
 // Returns 0 on success, -errno on failure
-static int hosp_write(hosp_device* hosp, unsigned char type) {
-  hosp->buf[0] = 0x00;
-  hosp->buf[1] = type;
+static int hosp_write_raw(hosp_device* hosp, unsigned char type) {
+  unsigned char buf[HOSP_BUF_SIZE] = { 0 };
+  buf[1] = type;
 #if HOSP_DEBUG
-  printf("hosp_write: %s\n", hosp->buf);
+  printf("hosp_write: %s\n", buf);
 #endif
+  if (hosp->dev == NULL) {
+    // disconnected
+    errno = ENODEV;
+    return -ENODEV;
+  }
   errno = 0;
-  if (hid_write(hosp->dev, hosp->buf, sizeof(hosp->buf)) == -1) {
+  if (hid_write(hosp->dev, buf, sizeof(buf)) == -1) {
     // HIDAPI not guaranteed to set errno
     if (!errno) {
       errno = EIO;
@@ -49,12 +150,22 @@ static int hosp_write(hosp_device* hosp, unsigned char type) {
   return 0;
 }
 
-// Returns 0 on success, -errno on failure, 1 if data is not ready
-static int hosp_read(hosp_device* hosp, unsigned char type) {
-  hosp->buf[0] = 0x00;
-  hosp->buf[1] = type;
+// Read any reply from the device; returns 0 on success, -errno on failure, 1 if none is available before the timeout
+static int hosp_read_raw(hosp_device* hosp, unsigned char* buf, int timeout_ms) {
+  int ret;
+  buf[0] = 0x00;
+  if (hosp->dev == NULL) {
+    // disconnected
+    errno = ENODEV;
+    return -ENODEV;
+  }
   errno = 0;
-  if (hid_read(hosp->dev, hosp->buf, sizeof(hosp->buf)) == -1) {
+  if (timeout_ms == HOSP_READ_ONCE) {
+    ret = hid_read(hosp->dev, buf, HOSP_BUF_SIZE);
+  } else {
+    ret = hid_read_timeout(hosp->dev, buf, HOSP_BUF_SIZE, timeout_ms);
+  }
+  if (ret == -1) {
     // HIDAPI not guaranteed to set errno
     if (!errno) {
       errno = EIO;
@@ -62,9 +173,212 @@ static int hosp_read(hosp_device* hosp, unsigned char type) {
     return -errno;
   }
 #if HOSP_DEBUG
-  printf("hosp_read: %s\n", hosp->buf);
+  if (ret) {
+    printf("hosp_read: %s\n", buf);
+  }
 #endif
-  return hosp->buf[0] != type;
+  return ret == 0;
+}
+
+// Count a request of a type that gets a reply, before its reply can possibly be read
+static void hosp_expect(hosp_device* hosp, unsigned int idx) {
+  pthread_mutex_lock(&hosp->lock);
+  hosp->pending[idx]++;
+  pthread_mutex_unlock(&hosp->lock);
+}
+
+// Forget a pending request of each type in a bitmask that will never get a reply, e.g., because its write failed; must
+// hold the lock
+static void hosp_forget_locked(hosp_device* hosp, unsigned int mask) {
+  unsigned int idx;
+  for (idx = 0; idx < HOSP_REPLY_TYPES; idx++) {
+    if ((mask & (1U << idx)) && hosp->pending[idx]) {
+      hosp->pending[idx]--;
+      if (hosp->stale[idx] > hosp->pending[idx]) {
+        hosp->stale[idx] = hosp->pending[idx];
+      }
+    }
+  }
+}
+
+static void hosp_forget(hosp_device* hosp, unsigned int mask) {
+  pthread_mutex_lock(&hosp->lock);
+  hosp_forget_locked(hosp, mask);
+  pthread_mutex_unlock(&hosp->lock);
+}
+
+// Returns 0 on success, -errno on failure
+static int hosp_write(hosp_device* hosp, unsigned char type) {
+  unsigned int idx = hosp_reply_index(type);
+  int ret;
+  if (idx < HOSP_REPLY_TYPES) {
+    hosp_expect(hosp, idx);
+  }
+  if ((ret = hosp_write_raw(hosp, type)) && idx < HOSP_REPLY_TYPES) {
+    hosp_forget(hosp, 1U << idx);
+  }
+  hosp_stats_write(hosp, type, ret);
+  return ret;
+}
+
+// Take the oldest reply from a mailbox; must hold the lock
+static void hosp_mail_take_locked(hosp_device* hosp, unsigned int idx, unsigned char* buf) {
+  memcpy(buf, hosp->mailbox[idx][hosp->mail_head[idx]], HOSP_BUF_SIZE);
+  hosp->mail_head[idx] = (hosp->mail_head[idx] + 1) % HOSP_MAILBOX_LEN;
+  if (!--hosp->mail_len[idx]) {
+    hosp->mail &= ~(1U << idx);
+  }
+}
+
+static void hosp_mail_clear_locked(hosp_device* hosp, unsigned int idx) {
+  hosp->mail_head[idx] = 0;
+  hosp->mail_len[idx] = 0;
+  hosp->mail &= ~(1U << idx);
+}
+
+// Abandon a pending request of each type in a bitmask whose reply may still come, e.g., after a timeout: discard a
+// reply of its type that already arrived, or else the next one to arrive, since the device replies in order; must hold
+// the lock
+static void hosp_abandon_locked(hosp_device* hosp, unsigned int mask) {
+  unsigned char buf[HOSP_BUF_SIZE];
+  unsigned int idx;
+  for (idx = 0; idx < HOSP_REPLY_TYPES; idx++) {
+    if (!(mask & (1U << idx))) {
+      continue;
+    }
+    if (hosp->mail_len[idx]) {
+      hosp_mail_take_locked(hosp, idx, buf);
+    } else if (hosp->pending[idx] > hosp->stale[idx]) {
+      hosp->stale[idx]++;
+    }
+  }
+}
+
+static void hosp_abandon(hosp_device* hosp, unsigned int mask) {
+  pthread_mutex_lock(&hosp->lock);
+  hosp_abandon_locked(hosp, mask);
+  pthread_mutex_unlock(&hosp->lock);
+}
+
+// Route a reply read by the leader; returns 1 if its type is in the mask, otherwise leaves it in its type's mailbox
+// (dropping the oldest one there if it's full), or discards it if nothing is pending for it or its request was
+// abandoned, and returns 0; must hold the lock
+static int hosp_route_locked(hosp_device* hosp, unsigned int mask, const unsigned char* buf) {
+  unsigned int idx = hosp_reply_index(buf[0]);
+  if (idx >= HOSP_REPLY_TYPES || !hosp->pending[idx]) {
+    return 0;
+  }
+  hosp->pending[idx]--;
+  if (hosp->stale[idx]) {
+    // the reply to an abandoned request
+    hosp->stale[idx]--;
+    return 0;
+  }
+  if (mask & (1U << idx)) {
+    return 1;
+  }
+  if (hosp->mail_len[idx] == HOSP_MAILBOX_LEN) {
+    hosp->mail_head[idx] = (hosp->mail_head[idx] + 1) % HOSP_MAILBOX_LEN;
+    hosp->mail_len[idx]--;
+  }
+  memcpy(hosp->mailbox[idx][(hosp->mail_head[idx] + hosp->mail_len[idx]++) % HOSP_MAILBOX_LEN], buf, HOSP_BUF_SIZE);
+  hosp->mail |= 1U << idx;
+  return 0;
+}
+
+// Wait for a reply to be routed or the leader to stop reading, until a CLOCK_MONOTONIC deadline (0 to wait
+// indefinitely); returns 0 if woken, or ETIMEDOUT if the deadline passed; must hold the lock
+static int hosp_wait_locked(hosp_device* hosp, uint64_t deadline_ns) {
+  if (!deadline_ns) {
+    pthread_cond_wait(&hosp->cond, &hosp->lock);
+    return 0;
+  }
+  if (hosp_time_ns() >= deadline_ns) {
+    return ETIMEDOUT;
+  }
+  // the caller checks for its reply before the deadline again, even if this times out
+  hosp_time_cond_timedwait_ns(&hosp->cond, &hosp->lock, deadline_ns);
+  return 0;
+}
+
+// Get a reply of any type in a bitmask, from its mailbox or from the device, which only one thread reads at a time
+// Returns 0 on success, -errno on failure, 1 if no reply is available before the timeout (or HOSP_READ_ONCE)
+static int hosp_receive(hosp_device* hosp, unsigned int mask, unsigned char* buf, int timeout_ms) {
+  uint64_t deadline = 0;
+  uint64_t now;
+  // without a timeout, don't wait for the leader, but still drain replies available from the device
+  int is_once = timeout_ms == HOSP_READ_ONCE;
+  int can_wait = timeout_ms != 0 && !is_once;
+  int is_ours;
+  int remaining_ms = timeout_ms;
+  int ret;
+  if (timeout_ms > 0) {
+    deadline = hosp_time_ns() + (uint64_t) timeout_ms * HOSP_NS_PER_MS;
+  }
+  pthread_mutex_lock(&hosp->lock);
+  for (;;) {
+    if (hosp->mail & mask) {
+      hosp_mail_take_locked(hosp, (unsigned int) __builtin_ctz(hosp->mail & mask), buf);
+      ret = 0;
+      break;
+    }
+    if (hosp->is_reading) {
+      // follow: another thread is reading, and will route our reply to us
+      if (!can_wait) {
+        ret = 1;
+        break;
+      }
+      hosp->followers++;
+      ret = hosp_wait_locked(hosp, deadline);
+      hosp->followers--;
+      if (ret) {
+        ret = 1;
+        break;
+      }
+      continue;
+    }
+    if (timeout_ms > 0) {
+      // only wait for what's left of the timeout, which may have been spent following or reading others' replies
+      now = hosp_time_ns();
+      if (now >= deadline) {
+        ret = 1;
+        break;
+      }
+      remaining_ms = (int) ((deadline - now + HOSP_NS_PER_MS - 1) / HOSP_NS_PER_MS);
+    }
+    // lead: read from the device without holding the lock, so other threads can check their mailboxes and write
+    hosp->is_reading = 1;
+    pthread_mutex_unlock(&hosp->lock);
+    ret = hosp_read_raw(hosp, buf, remaining_ms);
+    pthread_mutex_lock(&hosp->lock);
+    hosp->is_reading = 0;
+    is_ours = !ret && hosp_route_locked(hosp, mask, buf);
+    if (hosp->followers) {
+      // they may have mail or need to take over reading
+      pthread_cond_broadcast(&hosp->cond);
+    }
+    if (ret || is_ours || is_once) {
+      // failed, timed out, got our reply, or only one read was allowed
+      ret = ret ? ret : !is_ours;
+      break;
+    }
+    // a reply for another caller or a stale one, keep waiting for the remaining time
+  }
+  pthread_mutex_unlock(&hosp->lock);
+  return ret;
+}
+
+// Returns 0 on success, -errno on failure, 1 if data is not ready (before the timeout)
+// A request that times out is abandoned, so its late reply doesn't answer the next one; one that's only not ready with
+// HOSP_READ_ONCE is still pending, for the caller to read again
+static int hosp_read(hosp_device* hosp, unsigned char type, unsigned char* buf, int timeout_ms) {
+  unsigned int mask = 1U << hosp_reply_index(type);
+  int ret = hosp_receive(hosp, mask, buf, timeout_ms);
+  if (ret > 0 && timeout_ms != HOSP_READ_ONCE) {
+    hosp_abandon(hosp, mask);
+  }
+  hosp_stats_read(hosp, type, ret);
+  return ret;
 }
 
 struct hid_device_info* hosp_enumerate(void) {
@@ -98,19 +412,69 @@ hosp_device* hosp_open_device(hid_device* dev) {
   } else {
     hosp->dev = dev;
   }
+  pthread_mutex_init(&hosp->lock, NULL);
+  hosp_time_cond_init(&hosp->cond);
   return hosp;
 }
 
 int hosp_close(hosp_device* hosp) {
   errno = 0;
-  if (hosp->is_own_dev) {
+  if (hosp->is_own_dev && hosp->dev != NULL) {
     // close the HID device handle
     hid_close(hosp->dev);
   }
+  pthread_cond_destroy(&hosp->cond);
+  pthread_mutex_destroy(&hosp->lock);
   free(hosp);
   return -errno;
 }
 
+// Requests written to a device that's been replaced or disconnected will never get replies
+static void hosp_forget_requests(hosp_device* hosp) {
+  unsigned int idx;
+  hosp_async_reset(hosp);
+  pthread_mutex_lock(&hosp->lock);
+  memset(hosp->write_ns, 0, sizeof(hosp->write_ns));
+  memset(hosp->pending, 0, sizeof(hosp->pending));
+  memset(hosp->stale, 0, sizeof(hosp->stale));
+  for (idx = 0; idx < HOSP_REPLY_TYPES; idx++) {
+    hosp_mail_clear_locked(hosp, idx);
+  }
+  pthread_mutex_unlock(&hosp->lock);
+}
+
+int hosp_reopen(hosp_device* hosp, hid_device* dev) {
+  hid_device* old = hosp->is_own_dev ? hosp->dev : NULL;
+  if (dev == NULL) {
+    errno = 0;
+    if ((dev = hid_open(HOSP_VENDOR_ID, HOSP_PRODUCT_ID, NULL)) == NULL) {
+      if (!errno) {
+        errno = EIO;
+      }
+      return -errno;
+    }
+    hosp->is_own_dev = 1;
+  } else {
+    hosp->is_own_dev = 0;
+  }
+  hosp->dev = dev;
+  if (old != NULL) {
+    hid_close(old);
+  }
+  hosp_forget_requests(hosp);
+  return 0;
+}
+
+int hosp_disconnect(hosp_device* hosp) {
+  if (hosp->is_own_dev && hosp->dev != NULL) {
+    hid_close(hosp->dev);
+  }
+  hosp->dev = NULL;
+  hosp->is_own_dev = 0;
+  hosp_forget_requests(hosp);
+  return 0;
+}
+
 hid_device* hosp_get_device(hosp_device* hosp) {
   return hosp->dev;
 }
@@ -119,15 +483,32 @@ int hosp_request_version_write(hosp_device* hosp) {
   return hosp_write(hosp, HOSP_REQUEST_VERSION);
 }
 
+// Copy a version string of up to 16 characters, truncating it to fit
+static void hosp_copy_version(const char* version, char* buf, size_t bufsize) {
+  // strncpy and stpncpy get stringop-truncation warnings here, depending on the compiler's flags
+  size_t len = strnlen(version, bufsize < 17 ? bufsize - 1 : 16);
+  memcpy(buf, version, len);
+  buf[len] = '\0';
+}
+
+static void hosp_parse_version(const unsigned char* reply, char* buf, size_t bufsize) {
+  hosp_copy_version((const char*) &reply[1], buf, bufsize);
+}
+
 int hosp_request_version_read(hosp_device* hosp, char* buf, size_t bufsize) {
-  size_t bytes;
-  char* ptr;
+  unsigned char reply[HOSP_BUF_SIZE];
   int ret;
-  if (!(ret = hosp_read(hosp, HOSP_REQUEST_VERSION))) {
-    bytes = bufsize < 17 ? bufsize - 1 : 16;
-    // strncpy can get a stringop-truncation warning here, so use stpncpy
-    ptr = stpncpy(buf, (char*) &hosp->buf[1], bytes);
-    *ptr = '\0';
+  if (!(ret = hosp_read(hosp, HOSP_REQUEST_VERSION, reply, HOSP_READ_ONCE))) {
+    hosp_parse_version(reply, buf, bufsize);
+  }
+  return ret;
+}
+
+int hosp_request_version_read_timeout(hosp_device* hosp, char* buf, size_t bufsize, int timeout_ms) {
+  unsigned char reply[HOSP_BUF_SIZE];
+  int ret;
+  if (!(ret = hosp_read(hosp, HOSP_REQUEST_VERSION, reply, timeout_ms))) {
+    hosp_parse_version(reply, buf, bufsize);
   }
   return ret;
 }
@@ -136,15 +517,29 @@ int hosp_request_status_write(hosp_device* hosp) {
   return hosp_write(hosp, HOSP_REQUEST_STATUS);
 }
 
+static void hosp_parse_status(const unsigned char* reply, int* is_on, int* is_started) {
+  if (is_on) {
+    *is_on = (reply[2] == HOSP_STATUS_ON);
+  }
+  if (is_started) {
+    *is_started = (reply[1] == HOSP_STATUS_STARTED);
+  }
+}
+
 int hosp_request_status_read(hosp_device* hosp, int* is_on, int* is_started) {
+  unsigned char reply[HOSP_BUF_SIZE];
   int ret;
-  if (!(ret = hosp_read(hosp, HOSP_REQUEST_STATUS))) {
-    if (is_on) {
-      *is_on = (hosp->buf[2] == HOSP_STATUS_ON);
-    }
-    if (is_started) {
-      *is_started = (hosp->buf[1] == HOSP_STATUS_STARTED);
-    }
+  if (!(ret = hosp_read(hosp, HOSP_REQUEST_STATUS, reply, HOSP_READ_ONCE))) {
+    hosp_parse_status(reply, is_on, is_started);
+  }
+  return ret;
+}
+
+int hosp_request_status_read_timeout(hosp_device* hosp, int* is_on, int* is_started, int timeout_ms) {
+  unsigned char reply[HOSP_BUF_SIZE];
+  int ret;
+  if (!(ret = hosp_read(hosp, HOSP_REQUEST_STATUS, reply, timeout_ms))) {
+    hosp_parse_status(reply, is_on, is_started);
   }
   return ret;
 }
@@ -157,34 +552,273 @@ int hosp_request_startstop_write(hosp_device* hosp) {
   return hosp_write(hosp, HOSP_REQUEST_STARTSTOP);
 }
 
-static void hosp_str_units_to_milliunits(const char* str, size_t len, unsigned int* val) {
-  size_t s;
-  if (val != NULL) {
-    if (str[0] == '-') {
-      // device is off
-      *val = 0;
-    } else {
-      *val = 1000 * (unsigned int) atoi(str);
-      for (s = 1; s < len && str[s - 1] != '.'; s++);
-      *val += (unsigned int) atoi(&str[s]);
-    }
-  }
-}
-
 int hosp_request_data_write(hosp_device* hosp) {
   return hosp_write(hosp, HOSP_REQUEST_DATA);
 }
 
 int hosp_request_data_read(hosp_device* hosp, unsigned int* mV, unsigned int* mA, unsigned int* mW, unsigned int* mWh) {
+  unsigned char reply[HOSP_BUF_SIZE];
+  int ret;
+  if (!(ret = hosp_read(hosp, HOSP_REQUEST_DATA, reply, HOSP_READ_ONCE))) {
+    ret = hosp_parse_data(reply, mV, mA, mW, mWh);
+  }
+  return ret;
+}
+
+int hosp_request_data_read_timeout(hosp_device* hosp, unsigned int* mV, unsigned int* mA, unsigned int* mW,
+                                   unsigned int* mWh, int timeout_ms) {
+  unsigned char reply[HOSP_BUF_SIZE];
+  int ret;
+  if (!(ret = hosp_read(hosp, HOSP_REQUEST_DATA, reply, timeout_ms))) {
+    ret = hosp_parse_data(reply, mV, mA, mW, mWh);
+  }
+  return ret;
+}
+
+void hosp_get_stats(hosp_device* hosp, hosp_stats* stats) {
+  size_t i;
+  stats->writes = __atomic_load_n(&hosp->stats.writes, __ATOMIC_RELAXED);
+  stats->write_errors = __atomic_load_n(&hosp->stats.write_errors, __ATOMIC_RELAXED);
+  stats->reads = __atomic_load_n(&hosp->stats.reads, __ATOMIC_RELAXED);
+  stats->reads_not_ready = __atomic_load_n(&hosp->stats.reads_not_ready, __ATOMIC_RELAXED);
+  stats->read_errors = __atomic_load_n(&hosp->stats.read_errors, __ATOMIC_RELAXED);
+  for (i = 0; i < HOSP_STATS_LATENCY_BUCKETS; i++) {
+    stats->latency[i] = __atomic_load_n(&hosp->stats.latency[i], __ATOMIC_RELAXED);
+  }
+}
+
+void hosp_reset_stats(hosp_device* hosp) {
+  size_t i;
+  __atomic_store_n(&hosp->stats.writes, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&hosp->stats.write_errors, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&hosp->stats.reads, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&hosp->stats.reads_not_ready, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&hosp->stats.read_errors, 0, __ATOMIC_RELAXED);
+  for (i = 0; i < HOSP_STATS_LATENCY_BUCKETS; i++) {
+    __atomic_store_n(&hosp->stats.latency[i], 0, __ATOMIC_RELAXED);
+  }
+}
+
+#ifdef HOSP_HIDRAW
+// Returns 1 if a descriptor taken from a HID device handle is the device's
+static int hosp_is_device_fd(int fd) {
+#ifdef HOSP_SIM
+  // the simulator's handle layout is our own
+  return fd >= 0;
+#else
+  // HIDAPI's handle layout is private and may change, so make sure it's really a hidraw descriptor for a HOSP device
+  struct hidraw_devinfo info;
+  return fd >= 0 && !ioctl(fd, HIDIOCGRAWINFO, &info) && (unsigned short) info.vendor == HOSP_VENDOR_ID &&
+         (unsigned short) info.product == HOSP_PRODUCT_ID;
+#endif
+}
+#endif
+
+int hosp_get_fd(hosp_device* hosp) {
+  if (hosp->dev == NULL) {
+    // disconnected
+    errno = ENODEV;
+    return -ENODEV;
+  }
+#ifdef HOSP_HIDRAW
+  // HIDAPI doesn't expose it, but its hidraw backend's device handle (and the simulator's) starts with the descriptor
+  int fd = *(const int*) (const void*) hosp->dev;
+  if (hosp_is_device_fd(fd)) {
+    return fd;
+  }
+#else
+  (void) hosp;
+#endif
+  errno = ENOTSUP;
+  return -ENOTSUP;
+}
+
+static const unsigned char hosp_async_requests[] = {
+  [HOSP_ASYNC_VERSION] = HOSP_REQUEST_VERSION,
+  [HOSP_ASYNC_STATUS] = HOSP_REQUEST_STATUS,
+  [HOSP_ASYNC_DATA] = HOSP_REQUEST_DATA
+};
+
+int hosp_async_submit(hosp_device* hosp, hosp_async_type type) {
   int ret;
-  if (!(ret = hosp_read(hosp, HOSP_REQUEST_DATA))) {
-    // Reply when device is off: "7 5.000V  -.--- A -.---W  -.---Wh" followed by garbage characters
-    // Dashes are replaced with actual values when device is on
-    // Volts are always shown, even when device is off
-    hosp_str_units_to_milliunits((char*) &hosp->buf[2], 5, mV);
-    hosp_str_units_to_milliunits((char*) &hosp->buf[10], 5, mA);
-    hosp_str_units_to_milliunits((char*) &hosp->buf[17], 6, mW);
-    hosp_str_units_to_milliunits((char*) &hosp->buf[24], 7, mWh);
+  if ((size_t) type >= sizeof(hosp_async_requests)) {
+    errno = EINVAL;
+    return -EINVAL;
+  }
+  if (hosp->async_len == HOSP_ASYNC_MAX_PENDING) {
+    errno = EBUSY;
+    return -EBUSY;
+  }
+  if (!(ret = hosp_write(hosp, hosp_async_requests[type]))) {
+    hosp->async_types[(hosp->async_head + hosp->async_len++) % HOSP_ASYNC_MAX_PENDING] = (unsigned char) type;
   }
   return ret;
 }
+
+// Returns the position of the oldest pending request for a reply type, or async_len if there isn't one
+static size_t hosp_async_find(const hosp_device* hosp, unsigned char request) {
+  size_t i;
+  for (i = 0; i < hosp->async_len; i++) {
+    if (hosp_async_requests[hosp->async_types[(hosp->async_head + i) % HOSP_ASYNC_MAX_PENDING]] == request) {
+      break;
+    }
+  }
+  return i;
+}
+
+// Returns the reply index of the pending asynchronous request at a position
+static unsigned int hosp_async_reply_index(const hosp_device* hosp, size_t pos) {
+  return hosp_reply_index(hosp_async_requests[hosp->async_types[(hosp->async_head + pos) % HOSP_ASYNC_MAX_PENDING]]);
+}
+
+// Returns a bitmask of the reply types of pending asynchronous requests
+static unsigned int hosp_async_mask(const hosp_device* hosp) {
+  unsigned int mask = 0;
+  size_t i;
+  for (i = 0; i < hosp->async_len; i++) {
+    mask |= 1U << hosp_async_reply_index(hosp, i);
+  }
+  return mask;
+}
+
+int hosp_async_on_readable(hosp_device* hosp, hosp_async_result* result) {
+  unsigned char reply[HOSP_BUF_SIZE];
+  size_t pos;
+  size_t i;
+  int ret;
+  // replies to other callers' requests are left for them, and stale ones are discarded
+  if ((ret = hosp_receive(hosp, hosp_async_mask(hosp), reply, 0)) < 0) {
+    hosp_stats_read(hosp, 0, ret);
+    return ret;
+  }
+  if (ret > 0) {
+    if (hosp->async_len) {
+      hosp_stats_read(hosp, 0, 1);
+    }
+    return 0;
+  }
+#if HOSP_DEBUG
+  printf("hosp_async_on_readable: %s\n", reply);
+#endif
+  hosp_stats_read(hosp, reply[0], 0);
+  // requests before the matching one lost their replies, which will never come
+  pos = hosp_async_find(hosp, reply[0]);
+  pthread_mutex_lock(&hosp->lock);
+  for (i = 0; i < pos; i++) {
+    hosp_forget_locked(hosp, 1U << hosp_async_reply_index(hosp, i));
+  }
+  pthread_mutex_unlock(&hosp->lock);
+  result->type = (hosp_async_type) hosp->async_types[(hosp->async_head + pos) % HOSP_ASYNC_MAX_PENDING];
+  hosp->async_head = (hosp->async_head + pos + 1) % HOSP_ASYNC_MAX_PENDING;
+  hosp->async_len -= pos + 1;
+  result->status = 0;
+  switch (result->type) {
+    case HOSP_ASYNC_VERSION:
+      hosp_parse_version(reply, result->version, sizeof(result->version));
+      break;
+    case HOSP_ASYNC_STATUS:
+      hosp_parse_status(reply, &result->is_on, &result->is_started);
+      break;
+    case HOSP_ASYNC_DATA:
+    default:
+      result->sample.timestamp_ns = hosp_time_ns();
+      result->status = hosp_parse_data(reply, &result->sample.mV, &result->sample.mA, &result->sample.mW,
+                                       &result->sample.mWh);
+      break;
+  }
+  return 1;
+}
+
+size_t hosp_async_pending(const hosp_device* hosp) {
+  return hosp->async_len;
+}
+
+void hosp_async_reset(hosp_device* hosp) {
+  size_t i;
+  pthread_mutex_lock(&hosp->lock);
+  // their replies may still come, or already be in the mailbox
+  for (i = 0; i < hosp->async_len; i++) {
+    hosp_abandon_locked(hosp, 1U << hosp_async_reply_index(hosp, i));
+  }
+  pthread_mutex_unlock(&hosp->lock);
+  hosp->async_head = 0;
+  hosp->async_len = 0;
+}
+
+int hosp_snapshot(hosp_device* hosp, char* version, size_t bufsize, int* is_on, int* is_started, hosp_sample* sample,
+                  int timeout_ms) {
+  unsigned char reply[HOSP_BUF_SIZE];
+  uint64_t deadline = 0;
+  uint64_t now;
+  int remaining_ms = timeout_ms;
+  unsigned int mask = 0;
+  int has_version;
+  int ret = 0;
+  if (timeout_ms > 0) {
+    deadline = hosp_time_ns() + (uint64_t) timeout_ms * HOSP_NS_PER_MS;
+  }
+  pthread_mutex_lock(&hosp->lock);
+  has_version = hosp->has_version;
+  pthread_mutex_unlock(&hosp->lock);
+  // write all the requests before reading any replies, so the device services them back-to-back
+  if (version != NULL && !has_version) {
+    if ((ret = hosp_write(hosp, HOSP_REQUEST_VERSION))) {
+      return ret;
+    }
+    mask |= 1U << hosp_reply_index(HOSP_REQUEST_VERSION);
+  }
+  if (is_on != NULL || is_started != NULL) {
+    if ((ret = hosp_write(hosp, HOSP_REQUEST_STATUS))) {
+      hosp_forget(hosp, mask);
+      return ret;
+    }
+    mask |= 1U << hosp_reply_index(HOSP_REQUEST_STATUS);
+  }
+  if (sample != NULL) {
+    if ((ret = hosp_write(hosp, HOSP_REQUEST_DATA))) {
+      hosp_forget(hosp, mask);
+      return ret;
+    }
+    mask |= 1U << hosp_reply_index(HOSP_REQUEST_DATA);
+  }
+  // replies are routed by type, so they may arrive in any order, e.g., if another thread is also using the device
+  while (mask) {
+    if ((ret = hosp_receive(hosp, mask, reply, remaining_ms))) {
+      hosp_stats_read(hosp, 0, ret);
+      // late replies are discarded
+      hosp_abandon(hosp, mask);
+      return ret;
+    }
+    hosp_stats_read(hosp, reply[0], 0);
+    mask &= ~(1U << hosp_reply_index(reply[0]));
+    switch (reply[0]) {
+      case HOSP_REQUEST_VERSION:
+        pthread_mutex_lock(&hosp->lock);
+        hosp_parse_version(reply, hosp->version, sizeof(hosp->version));
+        hosp->has_version = 1;
+        pthread_mutex_unlock(&hosp->lock);
+        break;
+      case HOSP_REQUEST_STATUS:
+        hosp_parse_status(reply, is_on, is_started);
+        break;
+      case HOSP_REQUEST_DATA:
+      default:
+        sample->timestamp_ns = hosp_time_ns();
+        if ((ret = hosp_parse_data(reply, &sample->mV, &sample->mA, &sample->mW, &sample->mWh))) {
+          hosp_abandon(hosp, mask);
+          return ret;
+        }
+        break;
+    }
+    if (timeout_ms > 0) {
+      now = hosp_time_ns();
+      remaining_ms = now < deadline ? (int) ((deadline - now + HOSP_NS_PER_MS - 1) / HOSP_NS_PER_MS) : 0;
+    }
+  }
+  if (version != NULL) {
+    pthread_mutex_lock(&hosp->lock);
+    hosp_copy_version(hosp->version, version, bufsize);
+    pthread_mutex_unlock(&hosp->lock);
+  }
+  return 0;
+}
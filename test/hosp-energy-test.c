@@ -0,0 +1,99 @@
+/**
+ * Check the energy accumulator's integration and its handling of device counter wraps, resets, and gaps.
+ */
+#include <stdint.h>
+#include <hosp.h>
+#include <hosp-energy.h>
+#include "hosp-test.h"
+
+#define HOSP_TEST_NS_PER_S UINT64_C(1000000000)
+
+static void hosp_test_update(hosp_energy* energy, uint64_t timestamp_ns, unsigned int mW, unsigned int mWh) {
+  hosp_sample s = { timestamp_ns, 5000, 0, mW, mWh };
+  hosp_energy_update(energy, &s);
+}
+
+static void hosp_test_integrate(void) {
+  hosp_energy energy;
+  uint64_t t;
+  hosp_energy_init(&energy);
+  // the first sample only sets the starting point
+  hosp_test_update(&energy, HOSP_TEST_NS_PER_S, 1000, 0);
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 0);
+  // 1 W for 1 s, then ramping to 3 W over 1 s
+  hosp_test_update(&energy, 2 * HOSP_TEST_NS_PER_S, 1000, 0);
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 1000000);
+  hosp_test_update(&energy, 3 * HOSP_TEST_NS_PER_S, 3000, 0);
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 3000000);
+  // a sample that isn't newer doesn't add energy
+  hosp_test_update(&energy, 3 * HOSP_TEST_NS_PER_S, 3000, 0);
+  hosp_test_update(&energy, 2 * HOSP_TEST_NS_PER_S, 3000, 0);
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 3000000);
+
+  // sub-microjoule steps aren't lost: 1 mW for 1 us is 1 nJ, so 1000 of them are 1 uJ
+  hosp_energy_init(&energy);
+  for (t = 0; t <= 1000 * 1000; t += 1000) {
+    hosp_test_update(&energy, t, 1, 0);
+  }
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 1);
+}
+
+static void hosp_test_counter(void) {
+  hosp_energy energy;
+  hosp_energy_init(&energy);
+  hosp_test_update(&energy, 0, 72000, HOSP_ENERGY_MWH_MAX - 9);
+  hosp_test_update(&energy, HOSP_TEST_NS_PER_S, 72000, HOSP_ENERGY_MWH_MAX - 4);
+  HOSP_TEST_CHECK(hosp_energy_get_device_mWh(&energy) == 5);
+  // 72 W for 1 s is 20 mWh, which agrees with the counter wrapping
+  hosp_test_update(&energy, 2 * HOSP_TEST_NS_PER_S, 72000, 15);
+  HOSP_TEST_CHECK(hosp_energy_get_wraps(&energy) == 1 && hosp_energy_get_resets(&energy) == 0);
+  HOSP_TEST_CHECK(hosp_energy_get_device_mWh(&energy) == 25);
+  // but 1 mW doesn't, so the counter going backwards is a reset, which counts from zero
+  hosp_test_update(&energy, 3 * HOSP_TEST_NS_PER_S, 1, 15);
+  hosp_test_update(&energy, 4 * HOSP_TEST_NS_PER_S, 1, 2);
+  HOSP_TEST_CHECK(hosp_energy_get_wraps(&energy) == 1 && hosp_energy_get_resets(&energy) == 1);
+  HOSP_TEST_CHECK(hosp_energy_get_device_mWh(&energy) == 27);
+}
+
+static void hosp_test_gap(void) {
+  hosp_energy energy;
+  hosp_energy_init(&energy);
+  // there's nothing to bridge without a sample
+  hosp_energy_gap(&energy);
+  hosp_test_update(&energy, 0, 1000, 100);
+  HOSP_TEST_CHECK(hosp_energy_get_gaps(&energy) == 0);
+
+  // 1 W for 10 s is under 3 mWh, but the counter says at least 9 mWh were used
+  hosp_energy_gap(&energy);
+  hosp_test_update(&energy, 10 * HOSP_TEST_NS_PER_S, 1000, 110);
+  HOSP_TEST_CHECK(hosp_energy_get_gaps(&energy) == 1);
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 9 * HOSP_ENERGY_UJ_PER_MWH);
+  HOSP_TEST_CHECK(hosp_energy_get_device_mWh(&energy) == 10);
+
+  // 10 W for 10 s is almost 28 mWh, but the counter says at most 2 mWh were used
+  hosp_energy_gap(&energy);
+  hosp_test_update(&energy, 20 * HOSP_TEST_NS_PER_S, 10000, 111);
+  HOSP_TEST_CHECK(hosp_energy_get_gaps(&energy) == 2);
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 11 * HOSP_ENERGY_UJ_PER_MWH);
+  HOSP_TEST_CHECK(hosp_energy_get_device_mWh(&energy) == 11);
+
+  // within the counter's bounds, the integrated energy stands
+  hosp_energy_gap(&energy);
+  hosp_test_update(&energy, 21 * HOSP_TEST_NS_PER_S, 10000, 114);
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 11 * HOSP_ENERGY_UJ_PER_MWH + 10000000);
+  HOSP_TEST_CHECK(hosp_energy_get_device_mWh(&energy) == 14);
+
+  // a counter that went backwards during a gap was reset, so the gap used at least (nearly) what it counted since
+  hosp_energy_gap(&energy);
+  hosp_test_update(&energy, 22 * HOSP_TEST_NS_PER_S, 1, 5);
+  HOSP_TEST_CHECK(hosp_energy_get_resets(&energy) == 1 && hosp_energy_get_wraps(&energy) == 0);
+  HOSP_TEST_CHECK(hosp_energy_get_uJ(&energy) == 15 * HOSP_ENERGY_UJ_PER_MWH + 10000000);
+  HOSP_TEST_CHECK(hosp_energy_get_device_mWh(&energy) == 19);
+}
+
+int main(void) {
+  hosp_test_integrate();
+  hosp_test_counter();
+  hosp_test_gap();
+  return HOSP_TEST_RESULT();
+}
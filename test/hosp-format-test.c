@@ -0,0 +1,49 @@
+/**
+ * Check the integer formatter against snprintf, at digit count boundaries and for pseudo-random values.
+ */
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "format.h"
+#include "hosp-test.h"
+
+static void hosp_test_u64(uint64_t val) {
+  char expected[HOSP_FORMAT_U64_MAX + 1];
+  char buf[HOSP_FORMAT_U64_MAX + 1];
+  char* end;
+  int len = snprintf(expected, sizeof(expected), "%" PRIu64, val);
+  memset(buf, '#', sizeof(buf));
+  end = hosp_format_u64(buf, val);
+  HOSP_TEST_CHECK(end - buf == len && !memcmp(buf, expected, (size_t) len) && buf[len] == '#');
+  if (val <= UINT32_MAX) {
+    memset(buf, '#', sizeof(buf));
+    end = hosp_format_u32(buf, (uint32_t) val);
+    HOSP_TEST_CHECK(end - buf == len && !memcmp(buf, expected, (size_t) len) && buf[len] == '#');
+  }
+}
+
+int main(void) {
+  uint64_t pow10 = 1;
+  uint64_t x = 1;
+  int i;
+  hosp_test_u64(0);
+  // each number of digits, at its boundaries
+  for (i = 0; i < 20; i++) {
+    hosp_test_u64(pow10 - 1);
+    hosp_test_u64(pow10);
+    hosp_test_u64(pow10 + 1);
+    if (i < 19) {
+      pow10 *= 10;
+    }
+  }
+  hosp_test_u64(UINT32_MAX);
+  hosp_test_u64((uint64_t) UINT32_MAX + 1);
+  hosp_test_u64(UINT64_MAX);
+  // values of every magnitude
+  for (i = 0; i < 100000; i++) {
+    x = x * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+    hosp_test_u64(x >> (i % 64));
+  }
+  return HOSP_TEST_RESULT();
+}
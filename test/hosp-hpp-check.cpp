@@ -0,0 +1,54 @@
+/**
+ * Compile the header-only C++ wrapper, since nothing else in the build does.
+ * Nothing here is run; each function just uses part of the API the way users would.
+ */
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <hosp.hpp>
+
+static_assert(!std::is_copy_constructible<hosp::device>::value, "devices are move-only");
+static_assert(std::is_nothrow_move_constructible<hosp::device>::value, "devices are move-only");
+static_assert(std::is_same<std::iterator_traits<hosp::sample_range::iterator>::iterator_category,
+                           std::input_iterator_tag>::value, "sample ranges are single-pass");
+
+unsigned int hosp_hpp_check_samples(hosp::device& dev);
+unsigned int hosp_hpp_check_samples(hosp::device& dev) {
+  unsigned int mW = 0;
+  for (const hosp::sample& s : dev.samples(std::chrono::milliseconds(100), 10)) {
+    mW += s.mW;
+  }
+  hosp::sample_range range = dev.samples(std::chrono::milliseconds(100), 3, std::chrono::hours(24 * 365), 1);
+  hosp::sample_range::iterator it = range.begin();
+  if (it != range.end()) {
+    // the old sample outlives the increment that reads the next one
+    mW += (*it++).mW;
+    mW += it++->mA;
+    mW += it->mV;
+  }
+  return mW;
+}
+
+std::string hosp_hpp_check_device(const char* path);
+std::string hosp_hpp_check_device(const char* path) {
+  hosp::device dev(path);
+  hosp::device other = std::move(dev);
+  hosp::sample s;
+  hosp::status st = other.get_status(std::chrono::milliseconds(-1));
+  if (!st.on) {
+    other.toggle_onoff();
+  }
+  if (!other.try_read(s, std::chrono::milliseconds::max())) {
+    s = other.read(hosp::default_timeout, 2);
+  }
+  (void) hosp::timestamp(s);
+  (void) other.get_stats();
+  other.reset_stats();
+  other.disconnect();
+  other.reopen();
+  std::string version = other.version();
+  other.close();
+  return version;
+}
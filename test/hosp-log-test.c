@@ -0,0 +1,131 @@
+/**
+ * Check the binary log's encoding, and reading it back, including finding records by timestamp.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <hosp.h>
+#include <hosp-log.h>
+#include "hosp-test.h"
+
+#define HOSP_TEST_DEVICES 2
+#define HOSP_TEST_RECORDS 6
+
+// non-decreasing, with a repeat
+static const uint64_t timestamps[HOSP_TEST_RECORDS] = { 100, 200, 300, 300, 400, 500 };
+
+static int hosp_test_write(const char* path, const unsigned char* buf, size_t len) {
+  FILE* f;
+  int ret;
+  if ((f = fopen(path, "wb")) == NULL) {
+    perror(path);
+    return -1;
+  }
+  ret = fwrite(buf, 1, len, f) == len ? 0 : -1;
+  return fclose(f) || ret ? -1 : 0;
+}
+
+static void hosp_test_encode(void) {
+  unsigned char buf[HOSP_LOG_HEADER_SIZE];
+  unsigned char rec[HOSP_LOG_RECORD_SIZE(HOSP_TEST_DEVICES)];
+  hosp_sample samples[HOSP_TEST_DEVICES] = { { 0, 5000, 500, 2500, 1 }, { 0, 5100, 0x01020304, 0, 0 } };
+  int status[HOSP_TEST_DEVICES] = { 0, 1 };
+  static const unsigned char header[HOSP_LOG_HEADER_SIZE] = {
+    'H', 'O', 'S', 'P', 'L', 'O', 'G', 0, 1, 0, 0, 0, 32, 0, 0, 0, 40, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+  };
+  HOSP_TEST_CHECK(hosp_log_encode_header(buf, HOSP_TEST_DEVICES) == sizeof(buf));
+  HOSP_TEST_CHECK(!memcmp(buf, header, sizeof(header)));
+  // little-endian, with a device that has no data set to all ones
+  HOSP_TEST_CHECK(hosp_log_encode_record(rec, UINT64_C(0x0102030405060708), samples, NULL, 2) == sizeof(rec));
+  HOSP_TEST_CHECK(rec[0] == 0x08 && rec[7] == 0x01);
+  HOSP_TEST_CHECK(rec[8] == (5000 & 0xFF) && rec[9] == (5000 >> 8) && rec[10] == 0 && rec[11] == 0);
+  HOSP_TEST_CHECK(rec[28] == 0x04 && rec[29] == 0x03 && rec[30] == 0x02 && rec[31] == 0x01);
+  HOSP_TEST_CHECK(hosp_log_encode_record(rec, 0, samples, status, 2) == sizeof(rec));
+  HOSP_TEST_CHECK(rec[8] == (5000 & 0xFF) && rec[24] == 0xFF && rec[39] == 0xFF);
+}
+
+static void hosp_test_read(const char* path) {
+  unsigned char buf[HOSP_LOG_HEADER_SIZE + (HOSP_TEST_RECORDS + 1) * HOSP_LOG_RECORD_SIZE(HOSP_TEST_DEVICES)];
+  hosp_sample samples[HOSP_TEST_DEVICES];
+  hosp_sample s;
+  int status[HOSP_TEST_DEVICES];
+  hosp_log* log;
+  size_t len;
+  size_t i;
+
+  // the last record is partial, as if the writer was interrupted
+  len = hosp_log_encode_header(buf, HOSP_TEST_DEVICES);
+  for (i = 0; i < HOSP_TEST_RECORDS + 1; i++) {
+    samples[0].mV = 5000;
+    samples[0].mW = (unsigned int) i;
+    samples[1].mV = 5100;
+    samples[1].mW = (unsigned int) i * 2;
+    samples[0].mA = samples[0].mWh = samples[1].mA = samples[1].mWh = 0;
+    status[0] = 0;
+    status[1] = i == 2;
+    len += hosp_log_encode_record(&buf[len], i < HOSP_TEST_RECORDS ? timestamps[i] : 600, samples, status,
+                                  HOSP_TEST_DEVICES);
+  }
+  if (hosp_test_write(path, buf, len - 1)) {
+    hosp_test_failures++;
+    return;
+  }
+  if ((log = hosp_log_open(path)) == NULL) {
+    perror("hosp_log_open");
+    hosp_test_failures++;
+    return;
+  }
+  HOSP_TEST_CHECK(hosp_log_get_num_devices(log) == HOSP_TEST_DEVICES);
+  HOSP_TEST_CHECK(hosp_log_get_count(log) == HOSP_TEST_RECORDS);
+  for (i = 0; i < HOSP_TEST_RECORDS; i++) {
+    HOSP_TEST_CHECK(hosp_log_get_timestamp(log, i) == timestamps[i]);
+    HOSP_TEST_CHECK(hosp_log_get(log, i, 0, &s) == 0 && s.timestamp_ns == timestamps[i] && s.mV == 5000 &&
+                    s.mW == i);
+    if (i == 2) {
+      HOSP_TEST_CHECK(hosp_log_get(log, i, 1, &s) > 0 && s.mV == HOSP_LOG_INVALID);
+    } else {
+      HOSP_TEST_CHECK(hosp_log_get(log, i, 1, &s) == 0 && s.mV == 5100 && s.mW == i * 2);
+    }
+  }
+  HOSP_TEST_CHECK(hosp_log_get(log, HOSP_TEST_RECORDS, 0, &s) == -ERANGE);
+  HOSP_TEST_CHECK(hosp_log_get(log, 0, HOSP_TEST_DEVICES, &s) == -ERANGE);
+
+  // the first record at or after the time
+  HOSP_TEST_CHECK(hosp_log_find(log, 0) == 0);
+  HOSP_TEST_CHECK(hosp_log_find(log, 100) == 0);
+  HOSP_TEST_CHECK(hosp_log_find(log, 101) == 1);
+  HOSP_TEST_CHECK(hosp_log_find(log, 300) == 2);
+  HOSP_TEST_CHECK(hosp_log_find(log, 301) == 4);
+  HOSP_TEST_CHECK(hosp_log_find(log, 500) == 5);
+  HOSP_TEST_CHECK(hosp_log_find(log, 501) == HOSP_TEST_RECORDS);
+  HOSP_TEST_CHECK(hosp_log_close(log) == 0);
+
+  // a bad header is rejected
+  buf[8] = HOSP_LOG_VERSION + 1;
+  if (!hosp_test_write(path, buf, len)) {
+    errno = 0;
+    HOSP_TEST_CHECK(hosp_log_open(path) == NULL && errno == EINVAL);
+  }
+  // as is a truncated one
+  if (!hosp_test_write(path, buf, HOSP_LOG_HEADER_SIZE - 1)) {
+    errno = 0;
+    HOSP_TEST_CHECK(hosp_log_open(path) == NULL && errno == EINVAL);
+  }
+}
+
+int main(void) {
+  char path[] = "hosp-log-test-XXXXXX";
+  int fd;
+  hosp_test_encode();
+  if ((fd = mkstemp(path)) < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  hosp_test_read(path);
+  unlink(path);
+  return HOSP_TEST_RESULT();
+}
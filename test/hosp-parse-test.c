@@ -0,0 +1,82 @@
+/**
+ * Check the data reply parser on fixed replies, against expected values and the fuzz target's reference decoder.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include "hosp-parse.h"
+#include "hosp-test.h"
+
+// the fuzz target, which aborts if the parser and the reference decoder disagree
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+typedef struct hosp_test_vector {
+  // the volts, amps, watts, and watt-hours fields, which must have the device's field widths: 5, 5, 6, and 7
+  const char* fields[4];
+  // expected values, or -1 if the reply is malformed
+  long vals[4];
+} hosp_test_vector;
+
+static const hosp_test_vector vectors[] = {
+  // started
+  { { "5.000", "0.500", " 2.500", "  1.234" }, { 5000, 500, 2500, 1234 } },
+  // the largest values the fields hold
+  { { "9.999", "9.999", "99.999", "999.999" }, { 9999, 9999, 99999, 999999 } },
+  // stopped, and off
+  { { "5.000", "0.500", " 2.500", "  -.---" }, { 5000, 500, 2500, 0 } },
+  { { "5.000", "-.---", " -.---", "  -.---" }, { 5000, 0, 0, 0 } },
+  // fewer fractional digits, with more padding
+  { { " 5.25", "  0.5", "   2.5", "    1.2" }, { 5250, 500, 2500, 1200 } },
+  { { "  5.0", "0.000", "00.000", "000.000" }, { 5000, 0, 0, 0 } },
+  // malformed
+  { { "5.0a0", "0.500", " 2.500", "  1.234" }, { -1, -1, -1, -1 } },
+  { { " 5000", "0.500", " 2.500", "  1.234" }, { -1, -1, -1, -1 } },
+  { { "5.000", "0. 50", " 2.500", "  1.234" }, { -1, -1, -1, -1 } },
+  { { "5.000", "0.500", " .2500", "  1.234" }, { -1, -1, -1, -1 } },
+  { { "5.000", "0.500", "2.5000", "  1.234" }, { -1, -1, -1, -1 } },
+  { { "5.000", "0.500", " 2.500", "  1..23" }, { -1, -1, -1, -1 } },
+  { { "5.000", "0.500", " 2.500", "      ." }, { -1, -1, -1, -1 } },
+  { { "5.000", "0.500", " 2.500", "       " }, { -1, -1, -1, -1 } },
+  { { "5.000", "0.500", "x-.---", "  1.234" }, { -1, -1, -1, -1 } },
+  { { "5.000", "0.500", " 2.500", " -.--- " }, { -1, -1, -1, -1 } },
+};
+
+// Lay out a reply like the device's, e.g., "7 5.000V  0.500 A 2.500W  1.234Wh", followed by garbage
+static void hosp_test_reply(unsigned char* reply, const hosp_test_vector* v) {
+  memset(reply, 0xAA, HOSP_REPLY_SIZE);
+  memcpy(reply, "7 ", 2);
+  memcpy(&reply[2], v->fields[0], 5);
+  memcpy(&reply[7], "V  ", 3);
+  memcpy(&reply[10], v->fields[1], 5);
+  memcpy(&reply[15], " A", 2);
+  memcpy(&reply[17], v->fields[2], 6);
+  reply[23] = 'W';
+  memcpy(&reply[24], v->fields[3], 7);
+  memcpy(&reply[31], "Wh", 2);
+}
+
+int main(void) {
+  unsigned char reply[HOSP_REPLY_SIZE];
+  unsigned int vals[4];
+  size_t i;
+  int ret;
+  for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+    hosp_test_reply(reply, &vectors[i]);
+    LLVMFuzzerTestOneInput(reply, sizeof(reply));
+    memset(vals, 0, sizeof(vals));
+    errno = 0;
+    ret = hosp_parse_data(reply, &vals[0], &vals[1], &vals[2], &vals[3]);
+    if (vectors[i].vals[0] < 0) {
+      HOSP_TEST_CHECK(ret == -EBADMSG && errno == EBADMSG);
+    } else {
+      HOSP_TEST_CHECK(ret == 0);
+      HOSP_TEST_CHECK(vals[0] == (unsigned int) vectors[i].vals[0] && vals[1] == (unsigned int) vectors[i].vals[1] &&
+                      vals[2] == (unsigned int) vectors[i].vals[2] && vals[3] == (unsigned int) vectors[i].vals[3]);
+    }
+    if (ret == 0) {
+      // the outputs are optional
+      HOSP_TEST_CHECK(hosp_parse_data(reply, NULL, NULL, NULL, NULL) == 0);
+    }
+  }
+  return HOSP_TEST_RESULT();
+}
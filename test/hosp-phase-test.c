@@ -0,0 +1,50 @@
+/**
+ * Check the refresh phase estimate, which intersects the windows in which readings changed, modulo the refresh period.
+ */
+#include <stdint.h>
+#include <hosp.h>
+#include "phase.h"
+#include "hosp-test.h"
+
+#define HOSP_TEST_MS UINT64_C(1000000)
+
+static void hosp_test_add(hosp_phase* phase, uint64_t write_ms, uint64_t read_ms) {
+  hosp_phase_add_change(phase, write_ms * HOSP_TEST_MS, read_ms * HOSP_TEST_MS);
+}
+
+static int hosp_test_is_window(const hosp_phase* phase, uint64_t lo_ms, uint64_t hi_ms) {
+  return phase->lo == lo_ms * HOSP_TEST_MS && phase->hi == hi_ms * HOSP_TEST_MS;
+}
+
+int main(void) {
+  hosp_phase phase;
+  hosp_sample a = { 0, 5000, 500, 2500, 10 };
+  hosp_sample b = { 1, 5000, 500, 2500, 10 };
+
+  hosp_phase_init(&phase, HOSP_REFRESH_MS * HOSP_TEST_MS);
+  hosp_test_add(&phase, 50, 130);
+  HOSP_TEST_CHECK(phase.changes == 1 && hosp_test_is_window(&phase, 50, 130));
+  // two periods later, overlapping the end of the first window
+  hosp_test_add(&phase, 240, 280);
+  HOSP_TEST_CHECK(phase.changes == 2 && hosp_test_is_window(&phase, 50, 80));
+  // one period later, inside it
+  hosp_test_add(&phase, 160, 175);
+  HOSP_TEST_CHECK(phase.changes == 3 && hosp_test_is_window(&phase, 60, 75));
+
+  // requests are written just after the end of the window, in the next period that hasn't started yet
+  HOSP_TEST_CHECK(hosp_phase_next(&phase, 0) == 76 * HOSP_TEST_MS);
+  HOSP_TEST_CHECK(hosp_phase_next(&phase, 76 * HOSP_TEST_MS) == 76 * HOSP_TEST_MS);
+  HOSP_TEST_CHECK(hosp_phase_next(&phase, 76 * HOSP_TEST_MS + 1) == 176 * HOSP_TEST_MS);
+  HOSP_TEST_CHECK(hosp_phase_next(&phase, 500 * HOSP_TEST_MS) == 576 * HOSP_TEST_MS);
+
+  // a window that doesn't intersect means the phase drifted, so the estimate starts over from it
+  hosp_test_add(&phase, 390, 399);
+  HOSP_TEST_CHECK(phase.changes == 4 && hosp_test_is_window(&phase, 390, 399));
+
+  // duplicates are readings with the same values, whenever they were read
+  HOSP_TEST_CHECK(hosp_phase_is_duplicate(&a, &b));
+  b.mWh++;
+  HOSP_TEST_CHECK(!hosp_phase_is_duplicate(&a, &b));
+
+  return HOSP_TEST_RESULT();
+}
@@ -0,0 +1,80 @@
+/**
+ * Check the sample ring buffer's reads as the producer wraps around it and laps a consumer.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <hosp.h>
+#include "hosp-ring.h"
+#include "hosp-test.h"
+
+#define HOSP_TEST_CAPACITY 4
+
+static hosp_ring_slot slots[HOSP_TEST_CAPACITY];
+static uint64_t head;
+
+// Push samples until the head reaches the given sequence number, identifying each sample by its sequence number
+static void hosp_test_push_to(uint64_t seq) {
+  hosp_sample s;
+  memset(&s, 0, sizeof(s));
+  while (head < seq) {
+    s.timestamp_ns = head;
+    s.mW = (unsigned int) head * 10;
+    hosp_ring_push(slots, HOSP_TEST_CAPACITY, &head, &s);
+  }
+}
+
+// Check that the samples have consecutive sequence numbers from first
+static int hosp_test_is_seq(const hosp_sample* samples, size_t n, uint64_t first) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if (samples[i].timestamp_ns != first + i || samples[i].mW != (unsigned int) (first + i) * 10) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int main(void) {
+  hosp_sample samples[2 * HOSP_TEST_CAPACITY];
+  uint64_t cursor = 0;
+  size_t n;
+
+  // empty
+  HOSP_TEST_CHECK(hosp_ring_read(slots, HOSP_TEST_CAPACITY, &head, &cursor, samples, 8) == 0);
+  HOSP_TEST_CHECK(cursor == 0);
+
+  // partly full, then read in pieces
+  hosp_test_push_to(3);
+  n = hosp_ring_read(slots, HOSP_TEST_CAPACITY, &head, &cursor, samples, 2);
+  HOSP_TEST_CHECK(n == 2 && hosp_test_is_seq(samples, n, 0) && cursor == 2);
+  n = hosp_ring_read(slots, HOSP_TEST_CAPACITY, &head, &cursor, samples, 8);
+  HOSP_TEST_CHECK(n == 1 && hosp_test_is_seq(samples, n, 2) && cursor == 3);
+
+  // wrap around without overrunning the consumer
+  hosp_test_push_to(7);
+  n = hosp_ring_read(slots, HOSP_TEST_CAPACITY, &head, &cursor, samples, 8);
+  HOSP_TEST_CHECK(n == 4 && hosp_test_is_seq(samples, n, 3) && cursor == 7);
+
+  // a consumer that falls more than the capacity behind skips to the oldest sample still in the ring
+  hosp_test_push_to(17);
+  n = hosp_ring_read(slots, HOSP_TEST_CAPACITY, &head, &cursor, samples, 8);
+  HOSP_TEST_CHECK(n == HOSP_TEST_CAPACITY && hosp_test_is_seq(samples, n, 13) && cursor == 17);
+
+  // a new consumer starting from 0 gets the same
+  cursor = 0;
+  n = hosp_ring_read(slots, HOSP_TEST_CAPACITY, &head, &cursor, samples, 8);
+  HOSP_TEST_CHECK(n == HOSP_TEST_CAPACITY && hosp_test_is_seq(samples, n, 13) && cursor == 17);
+
+  // a cursor ahead of the head is pulled back to it
+  cursor = 100;
+  HOSP_TEST_CHECK(hosp_ring_read(slots, HOSP_TEST_CAPACITY, &head, &cursor, samples, 8) == 0);
+  HOSP_TEST_CHECK(cursor == 17);
+
+  // a slot being overwritten is skipped, as if the producer lapped the consumer mid-read
+  cursor = 14;
+  __atomic_store_n(&slots[14 % HOSP_TEST_CAPACITY].seq, 0, __ATOMIC_RELAXED);
+  n = hosp_ring_read(slots, HOSP_TEST_CAPACITY, &head, &cursor, samples, 8);
+  HOSP_TEST_CHECK(n == 2 && hosp_test_is_seq(samples, n, 15) && cursor == 17);
+
+  return HOSP_TEST_RESULT();
+}
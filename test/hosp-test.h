@@ -0,0 +1,22 @@
+/**
+ * Checks for the unit tests, which keep going after a failed check so one run reports all of them.
+ */
+#ifndef _HOSP_TEST_H_
+#define _HOSP_TEST_H_
+
+#include <stdio.h>
+
+static int hosp_test_failures;
+
+#define HOSP_TEST_CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      hosp_test_failures++; \
+    } \
+  } while (0)
+
+// Use as main's return value
+#define HOSP_TEST_RESULT() (hosp_test_failures ? 1 : 0)
+
+#endif
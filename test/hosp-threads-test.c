@@ -0,0 +1,305 @@
+/**
+ * Exercise a shared handle against the simulator, one case per run, selected by the first argument:
+ *   share     Three threads make different and overlapping requests; every request must get its own reply,
+ *             uncorrupted, before its timeout (the default)
+ *   late      A request times out and its reply comes late; the next request must get its own reply, not the late one
+ *   takeover  A follower takes over as leader when the leader's reply comes; it must still time out by its deadline
+ *   skip      An asynchronous request's reply is lost; the replies after it must still be collected, in order
+ * The timing cases expect HOSP_SIM_LATENCY_US=100000, and "skip" expects HOSP_SIM_QUEUE_LEN=1.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <hidapi.h>
+#include <hosp.h>
+
+#define HOSP_TEST_ITERATIONS 300
+#define HOSP_TEST_TIMEOUT_MS 250
+
+// the timing cases' simulated latency, and how late they allow a wakeup to be
+#define HOSP_TEST_LATENCY_MS 100
+#define HOSP_TEST_SLACK_MS   40
+
+// the simulator's defaults
+#define HOSP_TEST_VERSION "SMART POWER V3.0"
+#define HOSP_TEST_MV      5000
+
+typedef struct hosp_test_result {
+  const char* name;
+  unsigned int ok;
+  unsigned int timeouts;
+  unsigned int failures;
+} hosp_test_result;
+
+static hosp_device* hosp;
+
+static void hosp_test_count(hosp_test_result* result, int ret, int is_valid) {
+  if (ret > 0) {
+    result->timeouts++;
+  } else if (ret < 0 || !is_valid) {
+    result->failures++;
+  } else {
+    result->ok++;
+  }
+}
+
+// Request data, like a sampling thread
+static void* hosp_test_data(void* arg) {
+  hosp_test_result* result = (hosp_test_result*) arg;
+  unsigned int mV;
+  unsigned int mA;
+  unsigned int mW;
+  unsigned int mWh;
+  int ret;
+  int i;
+  for (i = 0; i < HOSP_TEST_ITERATIONS; i++) {
+    if ((ret = hosp_request_data_write(hosp)) == 0) {
+      ret = hosp_request_data_read_timeout(hosp, &mV, &mA, &mW, &mWh, HOSP_TEST_TIMEOUT_MS);
+    }
+    hosp_test_count(result, ret, ret || mV == HOSP_TEST_MV);
+  }
+  return NULL;
+}
+
+// Request the status, like a monitoring thread
+static void* hosp_test_status(void* arg) {
+  hosp_test_result* result = (hosp_test_result*) arg;
+  int is_on;
+  int is_started;
+  int ret;
+  int i;
+  for (i = 0; i < HOSP_TEST_ITERATIONS; i++) {
+    if ((ret = hosp_request_status_write(hosp)) == 0) {
+      ret = hosp_request_status_read_timeout(hosp, &is_on, &is_started, HOSP_TEST_TIMEOUT_MS);
+    }
+    hosp_test_count(result, ret, ret || (is_on && is_started));
+  }
+  return NULL;
+}
+
+// Pipeline all three request types, which overlap with the other threads' requests of each type
+static void* hosp_test_snapshot(void* arg) {
+  hosp_test_result* result = (hosp_test_result*) arg;
+  hosp_sample sample;
+  char version[17];
+  int is_on;
+  int is_started;
+  int ret;
+  int i;
+  for (i = 0; i < HOSP_TEST_ITERATIONS; i++) {
+    ret = hosp_snapshot(hosp, version, sizeof(version), &is_on, &is_started, &sample, HOSP_TEST_TIMEOUT_MS);
+    hosp_test_count(result, ret, ret || (!strcmp(version, HOSP_TEST_VERSION) && sample.mV == HOSP_TEST_MV));
+  }
+  return NULL;
+}
+
+static int hosp_test_share(void) {
+  void* (*fns[])(void*) = { hosp_test_data, hosp_test_status, hosp_test_snapshot };
+  hosp_test_result results[] = { { "data", 0, 0, 0 }, { "status", 0, 0, 0 }, { "snapshot", 0, 0, 0 } };
+  pthread_t threads[sizeof(fns) / sizeof(fns[0])];
+  size_t n = sizeof(fns) / sizeof(fns[0]);
+  size_t i;
+  int ret = 0;
+
+  for (i = 0; i < n; i++) {
+    if (pthread_create(&threads[i], NULL, fns[i], &results[i])) {
+      perror("pthread_create");
+      // let the others finish before closing
+      n = i;
+      ret = 1;
+      break;
+    }
+  }
+  for (i = 0; i < n; i++) {
+    pthread_join(threads[i], NULL);
+    printf("%s: ok=%u timeouts=%u failures=%u\n", results[i].name, results[i].ok, results[i].timeouts,
+           results[i].failures);
+    if (results[i].ok != HOSP_TEST_ITERATIONS) {
+      ret = 1;
+    }
+  }
+  return ret;
+}
+
+static uint64_t hosp_test_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+static void hosp_test_sleep_ms(long ms) {
+  struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+  nanosleep(&ts, NULL);
+}
+
+static int hosp_test_read_data(int timeout_ms) {
+  unsigned int mV;
+  unsigned int mA;
+  unsigned int mW;
+  unsigned int mWh;
+  return hosp_request_data_read_timeout(hosp, &mV, &mA, &mW, &mWh, timeout_ms);
+}
+
+static int hosp_test_late(void) {
+  uint64_t start;
+  uint64_t elapsed;
+  int ret;
+  start = hosp_test_ms();
+  if (hosp_request_data_write(hosp) || (ret = hosp_test_read_data(HOSP_TEST_LATENCY_MS / 10)) < 0) {
+    perror("hosp_request_data");
+    return 1;
+  }
+  if (ret == 0) {
+    fprintf(stderr, "late: the first request didn't time out\n");
+    return 1;
+  }
+  // the first reply comes while waiting, and must be discarded, so the second comes a latency after it
+  if (hosp_request_data_write(hosp) || hosp_test_read_data(4 * HOSP_TEST_LATENCY_MS)) {
+    perror("hosp_request_data");
+    return 1;
+  }
+  elapsed = hosp_test_ms() - start;
+  printf("late: second reply after %llu ms\n", (unsigned long long) elapsed);
+  if (elapsed + HOSP_TEST_SLACK_MS < 2 * HOSP_TEST_LATENCY_MS) {
+    fprintf(stderr, "late: the second request got the first one's reply\n");
+    return 1;
+  }
+  // and requests stay in step after that
+  start = hosp_test_ms();
+  if (hosp_request_data_write(hosp) || hosp_test_read_data(4 * HOSP_TEST_LATENCY_MS)) {
+    perror("hosp_request_data");
+    return 1;
+  }
+  elapsed = hosp_test_ms() - start;
+  printf("late: third reply after %llu ms\n", (unsigned long long) elapsed);
+  if (elapsed + HOSP_TEST_SLACK_MS < HOSP_TEST_LATENCY_MS) {
+    fprintf(stderr, "late: the third request got a stale reply\n");
+    return 1;
+  }
+  return 0;
+}
+
+static void* hosp_test_leader(void* arg) {
+  *(int*) arg = hosp_test_read_data(10 * HOSP_TEST_LATENCY_MS);
+  return NULL;
+}
+
+static int hosp_test_takeover(void) {
+  pthread_t leader;
+  uint64_t start;
+  uint64_t elapsed;
+  int is_on;
+  int is_started;
+  int leader_ret = -1;
+  int ret;
+  // the data reply comes after a latency and the status reply after two
+  if (hosp_request_data_write(hosp) || hosp_request_status_write(hosp)) {
+    perror("hosp_request_write");
+    return 1;
+  }
+  if (pthread_create(&leader, NULL, hosp_test_leader, &leader_ret)) {
+    perror("pthread_create");
+    return 1;
+  }
+  // let the other thread lead, then follow it until its reply comes and lead for the rest of the timeout, which ends
+  // before the status reply comes
+  hosp_test_sleep_ms(HOSP_TEST_LATENCY_MS / 5);
+  start = hosp_test_ms();
+  ret = hosp_request_status_read_timeout(hosp, &is_on, &is_started, 3 * HOSP_TEST_LATENCY_MS / 2);
+  elapsed = hosp_test_ms() - start;
+  pthread_join(leader, NULL);
+  printf("takeover: leader=%d follower=%d after %llu ms\n", leader_ret, ret, (unsigned long long) elapsed);
+  if (leader_ret != 0) {
+    fprintf(stderr, "takeover: the leader didn't get its reply\n");
+    return 1;
+  }
+  if (ret <= 0 || elapsed > 3 * HOSP_TEST_LATENCY_MS / 2 + HOSP_TEST_SLACK_MS) {
+    fprintf(stderr, "takeover: the follower didn't time out by its deadline\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int hosp_test_collect(hosp_async_result* result) {
+  uint64_t deadline = hosp_test_ms() + HOSP_TEST_TIMEOUT_MS;
+  int ret;
+  while ((ret = hosp_async_on_readable(hosp, result)) == 0 && hosp_test_ms() < deadline) {
+    hosp_test_sleep_ms(1);
+  }
+  if (ret < 0) {
+    perror("hosp_async_on_readable");
+  }
+  return ret;
+}
+
+static int hosp_test_skip(void) {
+  hosp_async_result result;
+  int i;
+  // with a one-reply queue, the version reply fills it, so the status reply is dropped
+  if (hosp_async_submit(hosp, HOSP_ASYNC_VERSION) || hosp_async_submit(hosp, HOSP_ASYNC_STATUS)) {
+    perror("hosp_async_submit");
+    return 1;
+  }
+  if (hosp_test_collect(&result) != 1 || result.type != HOSP_ASYNC_VERSION ||
+      strcmp(result.version, HOSP_TEST_VERSION)) {
+    fprintf(stderr, "skip: didn't collect the version reply\n");
+    return 1;
+  }
+  if (hosp_async_submit(hosp, HOSP_ASYNC_DATA)) {
+    perror("hosp_async_submit");
+    return 1;
+  }
+  if (hosp_test_collect(&result) != 1 || result.type != HOSP_ASYNC_DATA || result.status ||
+      result.sample.mV != HOSP_TEST_MV || hosp_async_pending(hosp)) {
+    fprintf(stderr, "skip: didn't collect the data reply after the lost status reply\n");
+    return 1;
+  }
+  // each type keeps getting its own replies after the skip
+  for (i = 0; i < 10; i++) {
+    if (hosp_async_submit(hosp, i % 2 ? HOSP_ASYNC_DATA : HOSP_ASYNC_STATUS)) {
+      perror("hosp_async_submit");
+      return 1;
+    }
+    if (hosp_test_collect(&result) != 1 || result.status ||
+        result.type != (i % 2 ? HOSP_ASYNC_DATA : HOSP_ASYNC_STATUS)) {
+      fprintf(stderr, "skip: request %d didn't get its own reply\n", i);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  const char* name = argc > 1 ? argv[1] : "share";
+  int ret;
+
+  if (hid_init() < 0) {
+    fprintf(stderr, "hid_init failed\n");
+    return 1;
+  }
+  if ((hosp = hosp_open()) == NULL) {
+    perror("hosp_open");
+    hid_exit();
+    return 1;
+  }
+  if (!strcmp(name, "share")) {
+    ret = hosp_test_share();
+  } else if (!strcmp(name, "late")) {
+    ret = hosp_test_late();
+  } else if (!strcmp(name, "takeover")) {
+    ret = hosp_test_takeover();
+  } else if (!strcmp(name, "skip")) {
+    ret = hosp_test_skip();
+  } else {
+    fprintf(stderr, "Unknown test: %s\n", name);
+    ret = 1;
+  }
+  if (hosp_close(hosp)) {
+    perror("hosp_close");
+    ret = 1;
+  }
+  hid_exit();
+  return ret;
+}
@@ -0,0 +1,56 @@
+/**
+ * Check the window's statistics and its percentile estimates, which are exact for small values and within the
+ * sketch's relative error for large ones.
+ */
+#include <stdint.h>
+#include "window.h"
+#include "hosp-test.h"
+
+// whether an estimate is within the sketch's relative error of the true value
+static int hosp_test_is_near(unsigned int est, unsigned int val) {
+  uint64_t err = est > val ? est - val : val - est;
+  return err * (2 * HOSP_WINDOW_SUB_BUCKETS) <= val;
+}
+
+int main(void) {
+  static hosp_window window;
+  unsigned int p;
+  unsigned int i;
+
+  hosp_window_reset(&window, 1234);
+  HOSP_TEST_CHECK(window.count == 0 && window.start_uJ == 1234);
+
+  // values below 2 * HOSP_WINDOW_SUB_BUCKETS are exact
+  for (i = 1; i <= 2 * HOSP_WINDOW_SUB_BUCKETS - 4; i++) {
+    hosp_window_add(&window, i);
+  }
+  HOSP_TEST_CHECK(window.count == 60 && window.sum_mW == 60 * 61 / 2 && window.min_mW == 1 && window.max_mW == 60);
+  HOSP_TEST_CHECK(hosp_window_percentile(&window, 1) == 1);
+  HOSP_TEST_CHECK(hosp_window_percentile(&window, 50) == 30);
+  HOSP_TEST_CHECK(hosp_window_percentile(&window, 90) == 54);
+  HOSP_TEST_CHECK(hosp_window_percentile(&window, 100) == 60);
+
+  // larger values are estimated
+  hosp_window_reset(&window, 0);
+  for (i = 1; i <= 10000; i++) {
+    hosp_window_add(&window, i * 10);
+  }
+  for (p = 1; p <= 100; p++) {
+    HOSP_TEST_CHECK(hosp_test_is_near(hosp_window_percentile(&window, p), p * 1000));
+  }
+  HOSP_TEST_CHECK(hosp_window_percentile(&window, 100) == 100000);
+
+  // the extremes are exact, so a window with one value always gets it
+  hosp_window_reset(&window, 0);
+  hosp_window_add(&window, 123457);
+  HOSP_TEST_CHECK(hosp_window_percentile(&window, 1) == 123457 && hosp_window_percentile(&window, 100) == 123457);
+
+  // the whole range of values fits
+  hosp_window_reset(&window, 0);
+  hosp_window_add(&window, 0);
+  hosp_window_add(&window, UINT32_MAX);
+  HOSP_TEST_CHECK(hosp_window_percentile(&window, 50) == 0);
+  HOSP_TEST_CHECK(hosp_window_percentile(&window, 100) == UINT32_MAX);
+
+  return HOSP_TEST_RESULT();
+}
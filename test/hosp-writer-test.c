@@ -0,0 +1,209 @@
+/**
+ * Check the output writer's overflow policies, with its thread stalled writing to a full pipe, and its flush policies.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "writer.h"
+#include "hosp-test.h"
+
+#define HOSP_TEST_CAPACITY 3
+#define HOSP_TEST_RECORD_MAX 8
+#define HOSP_TEST_STALL_MS 100
+
+typedef struct hosp_test_pipe {
+  int fds[2];
+  // how many bytes of filler were written to fill the pipe
+  size_t filler;
+  // everything read after the filler
+  char out[256];
+  size_t out_len;
+  pthread_t reader;
+} hosp_test_pipe;
+
+static void hosp_test_sleep_ms(long ms) {
+  struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+  nanosleep(&ts, NULL);
+}
+
+// Read until the write end is closed, keeping what comes after the filler
+static void* hosp_test_read(void* arg) {
+  hosp_test_pipe* p = (hosp_test_pipe*) arg;
+  char buf[4096];
+  size_t skip = p->filler;
+  size_t n;
+  ssize_t ret;
+  while ((ret = read(p->fds[0], buf, sizeof(buf))) > 0) {
+    n = (size_t) ret < skip ? (size_t) ret : skip;
+    skip -= n;
+    if ((size_t) ret - n > sizeof(p->out) - p->out_len) {
+      break;
+    }
+    memcpy(&p->out[p->out_len], &buf[n], (size_t) ret - n);
+    p->out_len += (size_t) ret - n;
+  }
+  return NULL;
+}
+
+// Open a pipe and fill it, so the writer stalls until the reader is started
+static int hosp_test_pipe_open(hosp_test_pipe* p) {
+  char buf[4096];
+  ssize_t ret;
+  int flags;
+  memset(p, 0, sizeof(*p));
+  memset(buf, 0, sizeof(buf));
+  if (pipe(p->fds)) {
+    perror("pipe");
+    return -1;
+  }
+  flags = fcntl(p->fds[1], F_GETFL);
+  fcntl(p->fds[1], F_SETFL, flags | O_NONBLOCK);
+  while ((ret = write(p->fds[1], buf, sizeof(buf))) > 0) {
+    p->filler += (size_t) ret;
+  }
+  fcntl(p->fds[1], F_SETFL, flags);
+  return 0;
+}
+
+static int hosp_test_pipe_drain(hosp_test_pipe* p) {
+  if (pthread_create(&p->reader, NULL, hosp_test_read, p)) {
+    perror("pthread_create");
+    return -1;
+  }
+  return 0;
+}
+
+static void hosp_test_pipe_close(hosp_test_pipe* p) {
+  close(p->fds[1]);
+  pthread_join(p->reader, NULL);
+  close(p->fds[0]);
+}
+
+static void* hosp_test_drain_later(void* arg) {
+  hosp_test_sleep_ms(HOSP_TEST_STALL_MS);
+  hosp_test_read(arg);
+  return NULL;
+}
+
+// Stall the writer on the first record, fill its queue, then push one more
+static void hosp_test_overflow(hosp_writer_overflow overflow, const char* expected, uint64_t dropped) {
+  static const char* records[] = { "r0\n", "r1\n", "r2\n", "r3\n", "r4\n" };
+  hosp_test_pipe p;
+  hosp_writer* writer;
+  size_t i;
+  if (hosp_test_pipe_open(&p)) {
+    hosp_test_failures++;
+    return;
+  }
+  if ((writer = hosp_writer_start(p.fds[1], HOSP_TEST_CAPACITY, HOSP_TEST_RECORD_MAX, overflow,
+                                  HOSP_WRITER_FLUSH_RECORD, 0)) == NULL) {
+    perror("hosp_writer_start");
+    hosp_test_failures++;
+    return;
+  }
+  HOSP_TEST_CHECK(hosp_writer_push(writer, records[0], strlen(records[0])) == 0);
+  // let the writer take the first record and block writing it
+  hosp_test_sleep_ms(HOSP_TEST_STALL_MS);
+  if (overflow == HOSP_WRITER_BLOCK) {
+    // the last push blocks until the pipe is drained
+    if (pthread_create(&p.reader, NULL, hosp_test_drain_later, &p)) {
+      perror("pthread_create");
+      hosp_test_failures++;
+      return;
+    }
+  }
+  for (i = 1; i < sizeof(records) / sizeof(records[0]); i++) {
+    HOSP_TEST_CHECK(hosp_writer_push(writer, records[i], strlen(records[i])) == 0);
+  }
+  HOSP_TEST_CHECK(hosp_writer_get_dropped(writer) == dropped);
+  if (overflow != HOSP_WRITER_BLOCK && hosp_test_pipe_drain(&p)) {
+    hosp_test_failures++;
+    return;
+  }
+  HOSP_TEST_CHECK(hosp_writer_stop(writer) == 0);
+  hosp_test_pipe_close(&p);
+  HOSP_TEST_CHECK(p.out_len == strlen(expected) && !memcmp(p.out, expected, p.out_len));
+}
+
+// Returns how many bytes are read within the timeout, or 0 if none are
+static size_t hosp_test_read_within(int fd, int timeout_ms) {
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  char buf[256];
+  ssize_t ret;
+  if (poll(&pfd, 1, timeout_ms) <= 0 || (ret = read(fd, buf, sizeof(buf))) <= 0) {
+    return 0;
+  }
+  return (size_t) ret;
+}
+
+static hosp_writer* hosp_test_start(int fd, hosp_writer_flush flush, uint64_t flush_arg) {
+  hosp_writer* writer = hosp_writer_start(fd, HOSP_TEST_CAPACITY, HOSP_TEST_RECORD_MAX, HOSP_WRITER_BLOCK, flush,
+                                          flush_arg);
+  if (writer == NULL) {
+    perror("hosp_writer_start");
+    hosp_test_failures++;
+  }
+  return writer;
+}
+
+static void hosp_test_flush(void) {
+  hosp_writer* writer;
+  int fds[2];
+  if (pipe(fds)) {
+    perror("pipe");
+    hosp_test_failures++;
+    return;
+  }
+
+  // each record as soon as it's queued
+  if ((writer = hosp_test_start(fds[1], HOSP_WRITER_FLUSH_RECORD, 0)) != NULL) {
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "abc\n", 4) == 0);
+    HOSP_TEST_CHECK(hosp_test_read_within(fds[0], 1000) == 4);
+    HOSP_TEST_CHECK(hosp_writer_stop(writer) == 0);
+  }
+
+  // once enough bytes are batched, or when stopping
+  if ((writer = hosp_test_start(fds[1], HOSP_WRITER_FLUSH_BYTES, 10)) != NULL) {
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "abc\n", 4) == 0);
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "def\n", 4) == 0);
+    HOSP_TEST_CHECK(hosp_test_read_within(fds[0], HOSP_TEST_STALL_MS) == 0);
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "ghi\n", 4) == 0);
+    HOSP_TEST_CHECK(hosp_test_read_within(fds[0], 1000) == 12);
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "jkl\n", 4) == 0);
+    HOSP_TEST_CHECK(hosp_writer_stop(writer) == 0);
+    HOSP_TEST_CHECK(hosp_test_read_within(fds[0], 0) == 4);
+  }
+
+  // once the oldest batched record is old enough
+  if ((writer = hosp_test_start(fds[1], HOSP_WRITER_FLUSH_MS, 2 * HOSP_TEST_STALL_MS)) != NULL) {
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "abc\n", 4) == 0);
+    HOSP_TEST_CHECK(hosp_test_read_within(fds[0], HOSP_TEST_STALL_MS) == 0);
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "def\n", 4) == 0);
+    HOSP_TEST_CHECK(hosp_test_read_within(fds[0], 10 * HOSP_TEST_STALL_MS) == 8);
+    HOSP_TEST_CHECK(hosp_writer_stop(writer) == 0);
+  }
+
+  // a write error stops the writer, and is reported to the producer
+  close(fds[0]);
+  if ((writer = hosp_test_start(fds[1], HOSP_WRITER_FLUSH_RECORD, 0)) != NULL) {
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "abc\n", 4) == 0);
+    hosp_test_sleep_ms(HOSP_TEST_STALL_MS);
+    HOSP_TEST_CHECK(hosp_writer_push(writer, "def\n", 4) == EPIPE);
+    HOSP_TEST_CHECK(hosp_writer_stop(writer) == EPIPE);
+  }
+  close(fds[1]);
+}
+
+int main(void) {
+  hosp_test_overflow(HOSP_WRITER_BLOCK, "r0\nr1\nr2\nr3\nr4\n", 0);
+  hosp_test_overflow(HOSP_WRITER_DROP_OLDEST, "r0\nr2\nr3\nr4\n", 1);
+  hosp_test_overflow(HOSP_WRITER_DROP_NEWEST, "r0\nr1\nr2\nr3\n", 1);
+  hosp_test_flush();
+  return HOSP_TEST_RESULT();
+}
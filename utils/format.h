@@ -0,0 +1,30 @@
+/**
+ * Fast integer formatting for utilities' output, without format string parsing or locale support.
+ */
+#ifndef _HOSP_FORMAT_H_
+#define _HOSP_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#pragma GCC visibility push(hidden)
+
+// The most characters written for a uint64_t
+#define HOSP_FORMAT_U64_MAX 20
+
+// Write the decimal digits of a value (without a NUL terminator); returns a pointer just past the last digit
+char* hosp_format_u64(char* buf, uint64_t val);
+
+// Like hosp_format_u64, but faster for values that fit in 32 bits
+char* hosp_format_u32(char* buf, uint32_t val);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -13,11 +13,15 @@
 #include "util.h"
 
 static const char* path = NULL;
+static int timeout_ms = HOSP_READ_TIMEOUT_MS;
+static unsigned int retries = HOSP_READ_RETRIES;
 
-static const char short_options[] = "hp:";
+static const char short_options[] = "hp:t:R:";
 static const struct option long_options[] = {
   {"help",      no_argument,       NULL, 'h'},
   {"path",      required_argument, NULL, 'p'},
+  {"timeout",   required_argument, NULL, 't'},
+  {"retries",   required_argument, NULL, 'R'},
   {0, 0, 0, 0}
 };
 
@@ -28,7 +32,10 @@ static void print_usage(int exit_code) {
           "Usage: hosp-get [OPTION]...\n"
           "Options:\n"
           "  -h, --help               Print this message and exit\n"
-          "  -p, --path               Device path (defaults to the first Smart Power found)\n");
+          "  -p, --path               Device path (defaults to the first Smart Power found)\n"
+          "  -t, --timeout=MS         Time to wait for a response, -1 to wait indefinitely (default=%d)\n"
+          "  -R, --retries=N          Number of times to resend a request that times out (default=%u)\n",
+          HOSP_READ_TIMEOUT_MS, HOSP_READ_RETRIES);
   exit(exit_code);
 }
 
@@ -42,6 +49,15 @@ static void parse_args(int argc, char** argv) {
       case 'p':
         path = optarg;
         break;
+      case 't':
+        if (hosp_util_parse_timeout(optarg, &timeout_ms)) {
+          fprintf(stderr, "Timeout must be an integer >= -1\n");
+          print_usage(EINVAL);
+        }
+        break;
+      case 'R':
+        retries = (unsigned int) strtoul(optarg, NULL, 0);
+        break;
       case '?':
       default:
         print_usage(EINVAL);
@@ -57,12 +73,10 @@ int main(int argc, char** argv) {
   char version[17];
   int is_on;
   int is_started;
-  unsigned int mV;
-  unsigned int mA;
-  unsigned int mW;
-  unsigned int mWh;
+  hosp_sample sample;
 
   parse_args(argc, argv);
+  hosp_util_set_read_policy(timeout_ms, retries);
 
   if (hid_init() < 0) {
     fprintf(stderr, "hid_init: %ls\n", hid_error(NULL));
@@ -88,15 +102,14 @@ int main(int argc, char** argv) {
     fprintf(stderr, "hid_set_nonblocking: %ls\n", hid_error(hosp_get_device(hosp)));
   }
 
-  if (hosp_util_get_version(hosp, version, sizeof(version)) ||
-      hosp_util_get_status(hosp, &is_on, &is_started) ||
-      hosp_util_get_data(hosp, &mV, &mA, &mW, &mWh)) {
+  if (hosp_util_get_snapshot(hosp, version, sizeof(version), &is_on, &is_started, &sample)) {
     ret = errno;
     perror("Failed to get status and data from ODROID Smart Power");
   } else {
     printf("Version: %s\n", version);
     printf("On: %d\nStarted: %d\n", is_on, is_started);
-    printf("Millivolts: %u\nMilliamps: %u\nMilliwatts: %u\nMilliwatt-hours: %u\n", mV, mA, mW, mWh);
+    printf("Millivolts: %u\nMilliamps: %u\nMilliwatts: %u\nMilliwatt-hours: %u\n", sample.mV, sample.mA,
+           sample.mW, sample.mWh);
   }
 
   if (hosp_close(hosp)) {
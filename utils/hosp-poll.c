@@ -6,69 +6,367 @@
  */
 #include <errno.h>
 #include <getopt.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <hidapi.h>
 #include <hosp.h>
+#include <hosp-energy.h>
+#include <hosp-group.h>
+#include <hosp-log.h>
+#include "hosp-time.h"
+#include "format.h"
+#include "hotplug.h"
+#include "jitter.h"
+#include "phase.h"
+#include "rt.h"
+#include "server.h"
 #include "util.h"
+#include "window.h"
+#include "writer.h"
 
 #define HOSP_DEFAULT_INTERVAL_MS 100
+#define HOSP_DEFAULT_BACKLOG 600
+#define HOSP_DEFAULT_QUEUE_LEN 1024
+// the longest interval that fits in interval_ms, and in nanoseconds
+#define HOSP_INTERVAL_MS_MAX (ULONG_MAX < HOSP_UTIL_MS_MAX ? ULONG_MAX : HOSP_UTIL_MS_MAX)
+// an upper bound on the length of any device's columns in a CSV row or header
+#define HOSP_OUT_DEVICE_MAX 320
+
+// stop learning the refresh phase after this many changes, or give up after this long
+#define HOSP_SYNC_CHANGES 5
+#define HOSP_SYNC_LEARN_MS 3000
 
 #ifndef HOSP_MAX_FAILURES
   #define HOSP_MAX_FAILURES 10
 #endif
 
-static const char* path = NULL;
+// while a device is lost, try to reopen it this often, and every round for this long after a device is plugged in
+#define HOSP_RECONNECT_RETRY_MS 1000
+
+// device paths, may be specified more than once
+static const char** paths = NULL;
+static size_t npaths = 0;
+// how to find each path's device again when reconnecting, empty to reopen the path
+static char (*identities)[HOSP_HOTPLUG_IDENTITY_LEN] = NULL;
+static int timeout_ms = HOSP_READ_TIMEOUT_MS;
+static unsigned int retries = HOSP_READ_RETRIES;
 static volatile int running = 1;
 static int restart = 0;
 static int count = 0;
 static unsigned long interval_ms = HOSP_DEFAULT_INTERVAL_MS;
+// if a sample overruns its period, skip the missed deadlines (1) or sample back-to-back until caught up (0)
+static int overrun_skip = 1;
+// output CSV (0) or binary log records (1)
+static int binary = 0;
+// print statistics to stderr at exit, and periodically if stats_period_s > 0
+static int stats = 0;
+static double stats_period_s = 0;
+// print a column of energy integrated by the host in microjoules
+static int energy = 0;
+// aggregate samples and print one row per window if window_s > 0
+static double window_s = 0;
+// stream rounds to subscribers on a Unix domain socket if listen_path is set, retaining backlog rounds for replay
+static const char* listen_path = NULL;
+static size_t backlog = HOSP_DEFAULT_BACKLOG;
+// schedule requests just after the device refreshes
+static int sync_refresh = 0;
+// after too many failures, wait up to reconnect_s seconds (0 for indefinitely) for lost devices to come back
+static int reconnect = 0;
+static double reconnect_s = 0;
+// protect sampling from the system under test: pin to a CPU if cpu >= 0, use a real-time scheduling policy at a
+// priority (its minimum if < 0), and lock memory
+static int cpu = -1;
+static int sched_policy = SCHED_OTHER;
+static int sched_priority = -1;
+static int lock_memory = 0;
+// how to handle readings that are the same as the previous one
+typedef enum hosp_dedup {
+  HOSP_DEDUP_NONE,
+  HOSP_DEDUP_MARK,
+  HOSP_DEDUP_SUPPRESS
+} hosp_dedup;
+static hosp_dedup dedup = HOSP_DEDUP_NONE;
+
+// output is queued for a writer thread, holding up to queue_len rows or records
+static size_t queue_len = HOSP_DEFAULT_QUEUE_LEN;
+static hosp_writer_overflow overflow = HOSP_WRITER_BLOCK;
+static hosp_writer_flush flush = HOSP_WRITER_FLUSH_RECORD;
+static uint64_t flush_arg = 0;
+
+// Each row or record is formatted into a buffer, then queued for the writer thread
+typedef struct hosp_out {
+  hosp_writer* writer;
+  char* buf;
+  size_t len;
+  size_t size;
+  // set if writing failed
+  int err;
+} hosp_out;
 
-static const char short_options[] = "hp:rc:i:";
+static const char* const window_columns[] = {
+  "Samples", "MinMilliwatts", "MaxMilliwatts", "MeanMilliwatts", "P50Milliwatts", "P95Milliwatts", "P99Milliwatts",
+  "Microjoules"
+};
+#define WINDOW_COLUMNS (sizeof(window_columns) / sizeof(window_columns[0]))
+
+static const char short_options[] = "hp:rc:i:O:Sd:f:q:o:F:s::ew:L:B:A:C:x:y:mt:R:";
 static const struct option long_options[] = {
   {"help",      no_argument,       NULL, 'h'},
   {"path",      required_argument, NULL, 'p'},
+  {"timeout",   required_argument, NULL, 't'},
+  {"retries",   required_argument, NULL, 'R'},
   {"restart",   no_argument,       NULL, 'r'},
   {"count",     required_argument, NULL, 'c'},
   {"interval",  required_argument, NULL, 'i'},
+  {"overrun",   required_argument, NULL, 'O'},
+  {"sync",      no_argument,       NULL, 'S'},
+  {"dedup",     required_argument, NULL, 'd'},
+  {"format",    required_argument, NULL, 'f'},
+  {"queue",     required_argument, NULL, 'q'},
+  {"overflow",  required_argument, NULL, 'o'},
+  {"flush",     required_argument, NULL, 'F'},
+  {"stats",     optional_argument, NULL, 's'},
+  {"energy",    no_argument,       NULL, 'e'},
+  {"window",    required_argument, NULL, 'w'},
+  {"listen",    required_argument, NULL, 'L'},
+  {"backlog",   required_argument, NULL, 'B'},
+  {"reconnect", required_argument, NULL, 'A'},
+  {"cpu",       required_argument, NULL, 'C'},
+  {"sched",     required_argument, NULL, 'x'},
+  {"priority",  required_argument, NULL, 'y'},
+  {"mlock",     no_argument,       NULL, 'm'},
   {0, 0, 0, 0}
 };
 
 __attribute__ ((noreturn))
 static void print_usage(int exit_code) {
   fprintf(exit_code ? stderr : stdout,
-          "Poll an ODROID Smart Power at regular intervals and print the results in CSV format.\n\n"
+          "Poll ODROID Smart Power(s) at regular intervals and print the results in CSV or binary format.\n\n"
           "Usage: hosp-poll [OPTION]...\n"
           "Options:\n"
           "  -h, --help               Print this message and exit\n"
           "  -p, --path               Device path (defaults to the first Smart Power found)\n"
+          "                           May be specified more than once to poll multiple devices together\n"
+          "  -t, --timeout=MS         Time to wait for a response, -1 to wait indefinitely (default=%d)\n"
+          "  -R, --retries=N          Number of times to resend a request that times out (default=%u)\n"
           "  -r, --restart            Restart the Watt-hour counter before polling\n"
           "  -c, --count=N            Stop after N reads\n"
-          "  -i, --interval=MS        The polling interval in milliseconds (default=%u)\n",
-          HOSP_DEFAULT_INTERVAL_MS);
+          "  -i, --interval=MS        The polling interval in milliseconds (default=%u)\n"
+          "  -O, --overrun=POLICY     How to handle samples that overrun the interval:\n"
+          "                           'skip' missed periods (default) or 'catchup' with back-to-back samples\n"
+          "  -S, --sync               Learn when the device refreshes and request samples just after\n"
+          "                           (one device only)\n"
+          "  -d, --dedup=POLICY       'mark' readings that are the same as the previous one with a column (CSV only),\n"
+          "                           or 'suppress' them\n"
+          "  -f, --format=FORMAT      Output 'csv' (default) or 'binary' log records (see hosp-log.h)\n"
+          "  -q, --queue=N            The number of rounds queued while output is blocked (default=%u)\n"
+          "  -o, --overflow=POLICY    How to handle a full output queue: 'block' sampling until there's room\n"
+          "                           (default), or drop the 'oldest' or 'newest' round\n"
+          "  -F, --flush=POLICY       When to write output: after each round with 'line' (default), or in batches\n"
+          "                           once 'bytes:N' are pending or the oldest round is 'ms:N' old\n"
+          "  -s, --stats[=SECONDS]    Print I/O and timing statistics to stderr on exit, and every SECONDS if set\n"
+          "  -e, --energy             Add a column of energy integrated from power samples in microjoules (CSV only)\n"
+          "  -w, --window=SECONDS     Print one row per window with power statistics and energy (CSV only)\n"
+          "  -L, --listen=PATH        Also stream binary log records to subscribers on a Unix domain socket at PATH\n"
+          "  -B, --backlog=N          The number of recent rounds retained for subscribers to replay (default=%u)\n"
+          "  -A, --reconnect=SECONDS  Instead of exiting after repeated failures, wait up to SECONDS (0 for no limit)\n"
+          "                           for the device to reconnect, e.g., after a USB reset, and find it again\n"
+          "  -C, --cpu=CPU            Pin sampling to a CPU\n"
+          "  -x, --sched=POLICY       Sample with the 'fifo' or 'rr' real-time scheduling policy\n"
+          "  -y, --priority=N         The real-time scheduling priority (defaults to the policy's minimum)\n"
+          "  -m, --mlock              Lock memory so sampling doesn't page fault\n",
+          HOSP_READ_TIMEOUT_MS, HOSP_READ_RETRIES, HOSP_DEFAULT_INTERVAL_MS, HOSP_DEFAULT_QUEUE_LEN,
+          HOSP_DEFAULT_BACKLOG);
   exit(exit_code);
 }
 
 static void parse_args(int argc, char** argv) {
+  uint64_t val;
   int c;
+  if ((paths = calloc((size_t) argc, sizeof(char*))) == NULL) {
+    perror("calloc");
+    exit(ENOMEM);
+  }
   while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
     switch (c) {
       case 'h':
         print_usage(0);
         break;
       case 'p':
-        path = optarg;
+        paths[npaths++] = optarg;
+        break;
+      case 'S':
+        sync_refresh = 1;
+        break;
+      case 'd':
+        if (!strcmp(optarg, "mark")) {
+          dedup = HOSP_DEDUP_MARK;
+        } else if (!strcmp(optarg, "suppress")) {
+          dedup = HOSP_DEDUP_SUPPRESS;
+        } else {
+          fprintf(stderr, "Unknown dedup policy: %s\n", optarg);
+          print_usage(EINVAL);
+        }
+        break;
+      case 'f':
+        if (!strcmp(optarg, "csv")) {
+          binary = 0;
+        } else if (!strcmp(optarg, "binary")) {
+          binary = 1;
+        } else {
+          fprintf(stderr, "Unknown format: %s\n", optarg);
+          print_usage(EINVAL);
+        }
+        break;
+      case 'q':
+        if (hosp_util_parse_u64(optarg, 1, SIZE_MAX, &val)) {
+          fprintf(stderr, "Queue length must be an integer > 0\n");
+          print_usage(EINVAL);
+        }
+        queue_len = (size_t) val;
+        break;
+      case 'o':
+        if (!strcmp(optarg, "block")) {
+          overflow = HOSP_WRITER_BLOCK;
+        } else if (!strcmp(optarg, "oldest")) {
+          overflow = HOSP_WRITER_DROP_OLDEST;
+        } else if (!strcmp(optarg, "newest")) {
+          overflow = HOSP_WRITER_DROP_NEWEST;
+        } else {
+          fprintf(stderr, "Unknown overflow policy: %s\n", optarg);
+          print_usage(EINVAL);
+        }
+        break;
+      case 'F':
+        if (!strcmp(optarg, "line")) {
+          flush = HOSP_WRITER_FLUSH_RECORD;
+        } else if (!strncmp(optarg, "bytes:", 6)) {
+          flush = HOSP_WRITER_FLUSH_BYTES;
+          if (hosp_util_parse_u64(optarg + 6, 1, SIZE_MAX, &flush_arg)) {
+            fprintf(stderr, "Flush size must be an integer > 0\n");
+            print_usage(EINVAL);
+          }
+        } else if (!strncmp(optarg, "ms:", 3)) {
+          flush = HOSP_WRITER_FLUSH_MS;
+          if (hosp_util_parse_u64(optarg + 3, 1, HOSP_UTIL_MS_MAX, &flush_arg)) {
+            fprintf(stderr, "Flush time must be an integer from 1 to %" PRIu64 "\n", HOSP_UTIL_MS_MAX);
+            print_usage(EINVAL);
+          }
+        } else {
+          fprintf(stderr, "Unknown flush policy: %s\n", optarg);
+          print_usage(EINVAL);
+        }
+        break;
+      case 's':
+        stats = 1;
+        if (optarg != NULL) {
+          if (hosp_util_parse_seconds(optarg, 0, HOSP_UTIL_S_MAX, &stats_period_s)) {
+            fprintf(stderr, "Statistics period must be a number of seconds >= 0\n");
+            print_usage(EINVAL);
+          }
+        }
+        break;
+      case 'e':
+        energy = 1;
+        break;
+      case 'w':
+        if (hosp_util_parse_seconds(optarg, 0, HOSP_UTIL_S_MAX, &window_s) || window_s <= 0) {
+          fprintf(stderr, "Window must be a number of seconds > 0\n");
+          print_usage(EINVAL);
+        }
+        break;
+      case 'L':
+        listen_path = optarg;
+        break;
+      case 'B':
+        if (hosp_util_parse_u64(optarg, 1, SIZE_MAX, &val)) {
+          fprintf(stderr, "Backlog must be an integer > 0\n");
+          print_usage(EINVAL);
+        }
+        backlog = (size_t) val;
+        break;
+      case 'A':
+        reconnect = 1;
+        if (hosp_util_parse_seconds(optarg, 0, HOSP_UTIL_S_MAX, &reconnect_s)) {
+          fprintf(stderr, "Reconnect time must be a number of seconds >= 0\n");
+          print_usage(EINVAL);
+        }
+        break;
+      case 'C':
+        if (hosp_util_parse_u64(optarg, 0, INT_MAX, &val)) {
+          fprintf(stderr, "CPU must be an integer >= 0\n");
+          print_usage(EINVAL);
+        }
+        cpu = (int) val;
+        break;
+      case 'x':
+        if (!strcmp(optarg, "fifo")) {
+          sched_policy = SCHED_FIFO;
+        } else if (!strcmp(optarg, "rr")) {
+          sched_policy = SCHED_RR;
+        } else {
+          fprintf(stderr, "Unknown scheduling policy: %s\n", optarg);
+          print_usage(EINVAL);
+        }
+        break;
+      case 'y':
+        if (hosp_util_parse_u64(optarg, 0, INT_MAX, &val)) {
+          fprintf(stderr, "Priority must be an integer >= 0\n");
+          print_usage(EINVAL);
+        }
+        sched_priority = (int) val;
+        break;
+      case 'm':
+        lock_memory = 1;
+        break;
+      case 't':
+        if (hosp_util_parse_timeout(optarg, &timeout_ms)) {
+          fprintf(stderr, "Timeout must be an integer >= -1\n");
+          print_usage(EINVAL);
+        }
+        break;
+      case 'R':
+        if (hosp_util_parse_u64(optarg, 0, UINT_MAX, &val)) {
+          fprintf(stderr, "Retries must be an integer >= 0\n");
+          print_usage(EINVAL);
+        }
+        retries = (unsigned int) val;
         break;
       case 'r':
         restart = 1;
         break;
       case 'c':
+        if (hosp_util_parse_u64(optarg, 1, INT_MAX, &val)) {
+          fprintf(stderr, "Count must be an integer > 0\n");
+          print_usage(EINVAL);
+        }
         count = 1;
-        running = atoi(optarg);
+        running = (int) val;
         break;
       case 'i':
-        interval_ms = strtoul(optarg, NULL, 0);
+        if (hosp_util_parse_u64(optarg, 0, HOSP_INTERVAL_MS_MAX, &val)) {
+          fprintf(stderr, "Interval must be an integer from 0 to %" PRIu64 "\n", (uint64_t) HOSP_INTERVAL_MS_MAX);
+          print_usage(EINVAL);
+        }
+        interval_ms = (unsigned long) val;
+        break;
+      case 'O':
+        if (!strcmp(optarg, "skip")) {
+          overrun_skip = 1;
+        } else if (!strcmp(optarg, "catchup")) {
+          overrun_skip = 0;
+        } else {
+          fprintf(stderr, "Unknown overrun policy: %s\n", optarg);
+          print_usage(EINVAL);
+        }
         break;
       case '?':
       default:
@@ -76,6 +374,30 @@ static void parse_args(int argc, char** argv) {
         break;
     }
   }
+  if ((energy || window_s > 0) && binary) {
+    fprintf(stderr, "Energy and windows are only supported with CSV output\n");
+    print_usage(EINVAL);
+  }
+  if (dedup == HOSP_DEDUP_MARK && (binary || window_s > 0)) {
+    fprintf(stderr, "Marking duplicates is only supported with CSV output, without windows\n");
+    print_usage(EINVAL);
+  }
+  if (sched_priority >= 0 && sched_policy == SCHED_OTHER) {
+    fprintf(stderr, "Priority requires a real-time scheduling policy\n");
+    print_usage(EINVAL);
+  }
+  if (sync_refresh && npaths > 1) {
+    fprintf(stderr, "Sync is only supported with one device\n");
+    print_usage(EINVAL);
+  }
+  if (sync_refresh && interval_ms % HOSP_REFRESH_MS) {
+    // requests can only be just after a refresh at multiples of the refresh period
+    interval_ms = (interval_ms + HOSP_REFRESH_MS / 2) / HOSP_REFRESH_MS * HOSP_REFRESH_MS;
+    if (!interval_ms) {
+      interval_ms = HOSP_REFRESH_MS;
+    }
+    fprintf(stderr, "Sync rounded the interval to %lu ms\n", interval_ms);
+  }
 }
 
 static void shandle(int sig) {
@@ -97,128 +419,736 @@ static void shandle(int sig) {
   }
 }
 
-static int hosp_restart(hosp_device* hosp) {
-  int ret = 0;
-  int is_on;
-  int is_started;
-  // get current status
-  if (hosp_util_get_status(hosp, &is_on, &is_started)) {
-    ret = errno;
-    perror("Failed to get status from ODROID Smart Power");
-    return ret;
+__attribute__ ((format (printf, 2, 3)))
+static void out_printf(hosp_out* out, const char* fmt, ...) {
+  va_list ap;
+  int len;
+  va_start(ap, fmt);
+  len = vsnprintf(out->buf + out->len, out->size - out->len, fmt, ap);
+  va_end(ap);
+  if (len > 0) {
+    // the buffer is sized for the longest row, but never overrun it
+    out->len += (size_t) len < out->size - out->len ? (size_t) len : out->size - out->len - 1;
   }
-  if (!is_on) {
-    // turn on
-    if (hosp_request_onoff_write(hosp)) {
-      ret = errno;
-      perror("Failed to turn on ODROID Smart Power");
-      return ret;
+}
+
+// Rows are formatted often, so fields are appended without printf; the buffer is sized so rows always fit
+
+static void out_str(hosp_out* out, const char* str) {
+  size_t len = strlen(str);
+  memcpy(out->buf + out->len, str, len);
+  out->len += len;
+}
+
+// Append a field, preceded by a separator unless it's NUL
+static void out_u64(hosp_out* out, char sep, uint64_t val) {
+  if (sep) {
+    out->buf[out->len++] = sep;
+  }
+  out->len = (size_t) (hosp_format_u64(out->buf + out->len, val) - out->buf);
+}
+
+static void out_u32(hosp_out* out, char sep, uint32_t val) {
+  if (sep) {
+    out->buf[out->len++] = sep;
+  }
+  out->len = (size_t) (hosp_format_u32(out->buf + out->len, val) - out->buf);
+}
+
+// Queue the formatted row or record for the writer thread
+static void out_queue(hosp_out* out) {
+  int err;
+  if (!out->err && (err = hosp_writer_push(out->writer, out->buf, out->len))) {
+    out->err = err;
+  }
+  out->len = 0;
+}
+
+static void print_header(hosp_out* out, size_t n) {
+  size_t i;
+  if (binary) {
+    out->len = hosp_log_encode_header((unsigned char*) out->buf, (uint32_t) n);
+    out_queue(out);
+    return;
+  }
+  if (window_s > 0) {
+    // columns are suffixed by device index if there's more than one
+    for (i = 0; i < n * WINDOW_COLUMNS; i++) {
+      out_printf(out, "%s%s", i ? "," : "", window_columns[i % WINDOW_COLUMNS]);
+      if (n > 1) {
+        out_printf(out, "%zu", i / WINDOW_COLUMNS);
+      }
     }
-  } else if (is_started) {
-    // stop
-    if (hosp_request_startstop_write(hosp)) {
-      ret = errno;
-      perror("Failed to stop ODROID Smart Power");
-      return ret;
+    out_printf(out, "\n");
+    out_queue(out);
+    return;
+  }
+  if (n == 1) {
+    out_printf(out, "Millivolts,Milliamps,Milliwatts,Milliwatt-hours%s%s\n", energy ? ",Microjoules" : "",
+               dedup == HOSP_DEDUP_MARK ? ",Duplicate" : "");
+    out_queue(out);
+    return;
+  }
+  // columns are suffixed by device index
+  for (i = 0; i < n; i++) {
+    out_printf(out, "%sMillivolts%zu,Milliamps%zu,Milliwatts%zu,Milliwatt-hours%zu", i ? "," : "", i, i, i, i);
+    if (energy) {
+      out_printf(out, ",Microjoules%zu", i);
+    }
+    if (dedup == HOSP_DEDUP_MARK) {
+      out_printf(out, ",Duplicate%zu", i);
     }
   }
-  // start
-  if (hosp_request_startstop_write(hosp)) {
-    ret = errno;
-    perror("Failed to start ODROID Smart Power");
-    return ret;
+  out_printf(out, "\n");
+  out_queue(out);
+}
+
+// A round is timestamped when its last reply was read, or now if no device replied
+static uint64_t round_timestamp_ns(size_t n, const hosp_sample* samples, const int* status) {
+  uint64_t timestamp_ns = 0;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if (!status[i] && samples[i].timestamp_ns > timestamp_ns) {
+      timestamp_ns = samples[i].timestamp_ns;
+    }
+  }
+  return timestamp_ns ? timestamp_ns : hosp_time_ns();
+}
+
+static void print_row(hosp_out* out, size_t n, const hosp_sample* samples, const int* status,
+                      const hosp_energy* energies, const int* dups) {
+  size_t i;
+  if (binary) {
+    out->len = hosp_log_encode_record((unsigned char*) out->buf, round_timestamp_ns(n, samples, status), samples,
+                                      status, n);
+    out_queue(out);
+    return;
+  }
+  for (i = 0; i < n; i++) {
+    if (status[i]) {
+      // leave fields empty for devices that failed this round
+      out_str(out, i ? ",,,," : ",,,");
+      if (energy) {
+        out_str(out, ",");
+      }
+      if (dedup == HOSP_DEDUP_MARK) {
+        out_str(out, ",");
+      }
+    } else {
+      out_u32(out, i ? ',' : '\0', samples[i].mV);
+      out_u32(out, ',', samples[i].mA);
+      out_u32(out, ',', samples[i].mW);
+      out_u32(out, ',', samples[i].mWh);
+      if (energy) {
+        out_u64(out, ',', hosp_energy_get_uJ(&energies[i]));
+      }
+      if (dedup == HOSP_DEDUP_MARK) {
+        out_u32(out, ',', (uint32_t) dups[i]);
+      }
+    }
+  }
+  out_str(out, "\n");
+  out_queue(out);
+}
+
+// Print a round's row, unless windows are printed instead, and publish it to subscribers
+static void emit_round(hosp_out* out, hosp_server* server, int is_row, size_t n, const hosp_sample* samples,
+                       const int* status, const hosp_energy* energies, const int* dups) {
+  if (is_row) {
+    print_row(out, n, samples, status, energies, dups);
+  }
+  if (server != NULL) {
+    hosp_server_publish(server, round_timestamp_ns(n, samples, status), samples, status);
+  }
+}
+
+static void print_window_row(hosp_out* out, size_t n, const hosp_window* windows, const hosp_energy* energies) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if (!windows[i].count) {
+      // leave fields empty for devices that didn't succeed during the window
+      out_str(out, i ? ",,,,,,,," : ",,,,,,,");
+      continue;
+    }
+    out_u64(out, i ? ',' : '\0', windows[i].count);
+    out_u32(out, ',', windows[i].min_mW);
+    out_u32(out, ',', windows[i].max_mW);
+    out_u64(out, ',', windows[i].sum_mW / windows[i].count);
+    out_u32(out, ',', hosp_window_percentile(&windows[i], 50));
+    out_u32(out, ',', hosp_window_percentile(&windows[i], 95));
+    out_u32(out, ',', hosp_window_percentile(&windows[i], 99));
+    out_u64(out, ',', hosp_energy_get_uJ(&energies[i]) - windows[i].start_uJ);
+  }
+  out_str(out, "\n");
+  out_queue(out);
+}
+
+static void print_stats(hosp_group* group, int summary) {
+  hosp_stats st;
+  char label[32];
+  size_t i;
+  for (i = 0; i < hosp_group_size(group); i++) {
+    hosp_get_stats(hosp_group_get_device(group, i), &st);
+    snprintf(label, sizeof(label), "Device %zu", i);
+    hosp_util_print_stats(stderr, label, &st, summary);
+  }
+}
+
+// Apply the CPU, scheduling, and memory locking options to the calling thread; returns 0 on success or errno
+static int setup_rt(void) {
+  int err;
+  if (cpu >= 0 && (err = hosp_rt_set_cpu(cpu))) {
+    fprintf(stderr, "Failed to pin sampling to CPU %d: %s\n", cpu, strerror(err));
+    return err;
+  }
+  if (sched_policy != SCHED_OTHER) {
+    if (sched_priority < 0) {
+      sched_priority = sched_get_priority_min(sched_policy);
+    }
+    if ((err = hosp_rt_set_sched(sched_policy, sched_priority))) {
+      fprintf(stderr, "Failed to set real-time scheduling priority %d: %s\n", sched_priority, strerror(err));
+      return err;
+    }
+  }
+  if (lock_memory && (err = hosp_rt_lock_memory())) {
+    fprintf(stderr, "Failed to lock memory: %s\n", strerror(err));
+    return err;
+  }
+  return 0;
+}
+
+static void print_jitter(const hosp_jitter* jitter) {
+  unsigned int i;
+  if (!jitter->count) {
+    return;
+  }
+  fprintf(stderr, "Jitter: intervals=%"PRIu64" min=%.3f ms max=%.3f ms mean=%.3f ms stddev=%.3f ms\n",
+          jitter->count, (double) jitter->min_ns / HOSP_NS_PER_MS, (double) jitter->max_ns / HOSP_NS_PER_MS,
+          jitter->mean_ns / HOSP_NS_PER_MS, hosp_jitter_stddev_ns(jitter) / HOSP_NS_PER_MS);
+  for (i = 0; i < HOSP_JITTER_BUCKETS; i++) {
+    if (jitter->buckets[i]) {
+      fprintf(stderr, "  deviation [%llu, %llu%s us: %"PRIu64"\n",
+              (unsigned long long) (i ? UINT64_C(1) << (i - 1) : 0), (unsigned long long) (UINT64_C(1) << i),
+              i < HOSP_JITTER_BUCKETS - 1 ? ")" : "+)", jitter->buckets[i]);
+    }
+  }
+}
+
+// Learn the device's refresh phase by sampling back-to-back and watching for changes; returns 0 on success or errno
+static int sync_learn(hosp_device* hosp, hosp_phase* phase, hosp_sample* prev) {
+  hosp_sample s;
+  uint64_t write_ns;
+  uint64_t prev_write_ns = 0;
+  uint64_t start_ns = hosp_time_ns();
+  int has_prev = 0;
+  while (running && phase->changes < HOSP_SYNC_CHANGES &&
+         hosp_time_ns() - start_ns < HOSP_SYNC_LEARN_MS * HOSP_NS_PER_MS) {
+    write_ns = hosp_time_ns();
+    if (hosp_util_get_data(hosp, &s.mV, &s.mA, &s.mW, &s.mWh)) {
+      return errno;
+    }
+    s.timestamp_ns = hosp_time_ns();
+    if (has_prev && !hosp_phase_is_duplicate(prev, &s)) {
+      hosp_phase_add_change(phase, prev_write_ns, s.timestamp_ns);
+    }
+    *prev = s;
+    prev_write_ns = write_ns;
+    has_prev = 1;
+  }
+  return phase->changes ? 0 : ENODATA;
+}
+
+// After a duplicate reading requested at write_ns, sample back-to-back for up to a refresh period until the reading
+// changes, then update the phase; returns 1 and sets s if the reading changed, 0 otherwise
+static int sync_probe(hosp_device* hosp, hosp_phase* phase, uint64_t write_ns, hosp_sample* s) {
+  hosp_sample p;
+  uint64_t start_ns = write_ns;
+  uint64_t now;
+  while ((now = hosp_time_ns()) - start_ns < phase->period_ns) {
+    if (hosp_util_get_data(hosp, &p.mV, &p.mA, &p.mW, &p.mWh)) {
+      return 0;
+    }
+    p.timestamp_ns = hosp_time_ns();
+    if (!hosp_phase_is_duplicate(s, &p)) {
+      hosp_phase_add_change(phase, write_ns, p.timestamp_ns);
+      *s = p;
+      return 1;
+    }
+    write_ns = now;
   }
-  // allow time for counter to restart
-  hosp_util_msleep(HOSP_DEFAULT_INTERVAL_MS);
   return 0;
 }
 
-static int hosp_poll(hosp_device* hosp) {
+// Identify a device in messages if there's more than one
+static const char* device_label(size_t n, size_t i, char* buf, size_t len) {
+  if (n == 1) {
+    return "ODROID Smart Power";
+  }
+  snprintf(buf, len, "ODROID Smart Power %zu", i);
+  return buf;
+}
+
+// Let go of a lost device right away, so the OS can release it, e.g., its hidraw node
+static void release_device(hosp_device* hosp, hid_device** hdev) {
+  hosp_disconnect(hosp);
+  if (*hdev != NULL) {
+    hid_close(*hdev);
+    *hdev = NULL;
+  }
+}
+
+// Reopen a lost device: the one with its original identity, or on its original path if it had no identity, or the first
+// device found without a path; returns 0 on success, errno on failure
+static int reopen_device(hosp_device* hosp, hid_device** hdev, size_t i) {
+  hid_device* dev = NULL;
+  int err;
+  if (npaths) {
+    errno = 0;
+    if ((dev = identities[i][0] ? hosp_hotplug_open_identity(identities[i]) : hid_open_path(paths[i])) == NULL) {
+      return errno ? errno : EIO;
+    }
+  }
+  if (hosp_reopen(hosp, dev)) {
+    err = errno;
+    if (dev != NULL) {
+      hid_close(dev);
+    }
+    return err;
+  }
+  *hdev = dev;
+  if (hid_set_nonblocking(hosp_get_device(hosp), 1) < 0) {
+    // Not a fatal error.
+    fprintf(stderr, "hid_set_nonblocking: %ls\n", hid_error(hosp_get_device(hosp)));
+  }
+  return 0;
+}
+
+static int hosp_poll(hosp_group* group, hid_device** hdevs) {
   int ret = 0;
-  unsigned int mV;
-  unsigned int mA;
-  unsigned int mW;
-  unsigned int mWh;
+  size_t n = hosp_group_size(group);
+  size_t i;
+  hosp_sample* samples;
+  int* status;
+  hosp_energy* energies;
+  hosp_window* windows = NULL;
+  hosp_server* server = NULL;
+  hosp_out out = { 0 };
+  uint64_t dropped;
+  // the previous reading from each device, and whether each device's reading this round is a duplicate of it
+  hosp_sample* prevs;
+  int* dups;
+  hosp_phase phase;
+  hosp_jitter jitter;
+  // when each lost device was lost, or 0 if it isn't
+  uint64_t* lost_ns;
+  size_t nlost = 0;
+  hosp_hotplug* hotplug = NULL;
+  uint64_t reconnect_ns = (uint64_t) (reconnect_s * (double) HOSP_NS_PER_S);
+  uint64_t retry_ns = 0;
+  uint64_t plugged_ns = 0;
+  char label[48];
+  int steady = 0;
+  int emit;
+  int err;
   unsigned int failures = 0;
+  unsigned long overruns = 0;
+  unsigned long skipped = 0;
+  uint64_t missed;
+  uint64_t now;
+  uint64_t interval_ns = interval_ms * HOSP_NS_PER_MS;
+  uint64_t deadline;
+  uint64_t start_ns;
+  uint64_t busy_ns = 0;
+  uint64_t stats_period_ns = (uint64_t) (stats_period_s * (double) HOSP_NS_PER_S);
+  uint64_t stats_deadline;
+  uint64_t window_ns = (uint64_t) (window_s * (double) HOSP_NS_PER_S);
+  uint64_t window_deadline;
+  uint64_t uJ;
+  uint64_t counted_uJ;
+  samples = calloc(n, sizeof(hosp_sample));
+  status = calloc(n, sizeof(int));
+  energies = calloc(n, sizeof(hosp_energy));
+  prevs = calloc(n, sizeof(hosp_sample));
+  dups = calloc(n, sizeof(int));
+  lost_ns = calloc(n, sizeof(uint64_t));
+  // rows are longer than binary records
+  out.size = n * HOSP_OUT_DEVICE_MAX;
+  out.buf = malloc(out.size);
+  if (window_ns) {
+    windows = malloc(n * sizeof(hosp_window));
+  }
+  if (samples == NULL || status == NULL || energies == NULL || prevs == NULL || dups == NULL || lost_ns == NULL ||
+      out.buf == NULL || (window_ns && windows == NULL)) {
+    ret = errno;
+    perror("malloc");
+    goto free_bufs;
+  }
+  if (listen_path != NULL && (server = hosp_server_open(listen_path, n, backlog)) == NULL) {
+    ret = errno;
+    fprintf(stderr, "Failed to listen on %s: %s\n", listen_path, strerror(ret));
+    goto free_bufs;
+  }
+  // the writer thread blocks on output so sampling doesn't have to
+  if ((out.writer = hosp_writer_start(STDOUT_FILENO, queue_len, out.size, overflow, flush, flush_arg)) == NULL) {
+    ret = errno;
+    perror("Failed to start output writer");
+    goto close_server;
+  }
+  // after starting the writer, which shouldn't compete with sampling
+  if ((ret = setup_rt())) {
+    hosp_writer_stop(out.writer);
+    goto close_server;
+  }
+  if (reconnect) {
+    // not fatal, lost devices are still retried periodically
+    hotplug = hosp_hotplug_open();
+  }
+  hosp_phase_init(&phase, HOSP_REFRESH_MS * HOSP_NS_PER_MS);
+  if (sync_refresh && (err = sync_learn(hosp_group_get_device(group, 0), &phase, &prevs[0]))) {
+    fprintf(stderr, "Failed to learn the refresh phase, not syncing: %s\n", strerror(err));
+    sync_refresh = 0;
+  }
+  for (i = 0; i < n; i++) {
+    hosp_energy_init(&energies[i]);
+    if (windows != NULL) {
+      hosp_window_reset(&windows[i], 0);
+    }
+  }
+  hosp_jitter_init(&jitter, interval_ns);
   // print header
-  printf("Millivolts,Milliamps,Milliwatts,Milliwatt-hours\n");
+  print_header(&out, n);
+  // schedule samples on absolute deadlines so time spent sampling doesn't accumulate as drift
+  start_ns = hosp_time_ns();
+  deadline = sync_refresh ? hosp_phase_next(&phase, start_ns) : start_ns;
+  if (sync_refresh) {
+    hosp_time_sleep_until_ns(deadline);
+  }
+  stats_deadline = start_ns + stats_period_ns;
+  window_deadline = start_ns + window_ns;
   while (running) {
     if (count) {
       running--;
     }
-    // get data
-    if (hosp_util_get_data(hosp, &mV, &mA, &mW, &mWh)) {
-      perror("Failed to get data from ODROID Smart Power");
+    if (nlost) {
+      // try to reopen lost devices periodically, and every round for a while after a device is plugged in, since it
+      // may not be ready right away
+      now = hosp_time_ns();
+      if (hotplug != NULL && hosp_hotplug_check(hotplug)) {
+        plugged_ns = now;
+      }
+      if (now >= retry_ns || now - plugged_ns < HOSP_RECONNECT_RETRY_MS * HOSP_NS_PER_MS) {
+        retry_ns = now + HOSP_RECONNECT_RETRY_MS * HOSP_NS_PER_MS;
+        for (i = 0; i < n; i++) {
+          if (!lost_ns[i] || reopen_device(hosp_group_get_device(group, i), &hdevs[i], i)) {
+            continue;
+          }
+          fprintf(stderr, "Reconnected %s after %.3f s\n", device_label(n, i, label, sizeof(label)),
+                  (double) (hosp_time_ns() - lost_ns[i]) / HOSP_NS_PER_S);
+          lost_ns[i] = 0;
+          nlost--;
+          // the device may have restarted, so its refresh phase is unknown
+          hosp_phase_init(&phase, HOSP_REFRESH_MS * HOSP_NS_PER_MS);
+          if (sync_refresh && (err = sync_learn(hosp_group_get_device(group, i), &phase, &prevs[i]))) {
+            fprintf(stderr, "Failed to relearn the refresh phase, not syncing: %s\n", strerror(err));
+            sync_refresh = 0;
+          }
+          // relearning isn't sampling jitter
+          hosp_jitter_skip(&jitter);
+        }
+      }
+      for (i = 0; i < n && reconnect_ns; i++) {
+        if (lost_ns[i] && now - lost_ns[i] >= reconnect_ns) {
+          ret = ENODEV;
+          running = 0;
+          fprintf(stderr, "%s didn't reconnect in time, exiting...\n", device_label(n, i, label, sizeof(label)));
+          break;
+        }
+      }
+      if (!running) {
+        break;
+      }
+    }
+    // get data from all devices at once
+    err = 0;
+    now = hosp_time_ns();
+    hosp_jitter_add(&jitter, now);
+    if (hosp_util_group_get_data(group, samples, status) < n) {
+      for (i = 0; i < n; i++) {
+        // lost devices are expected to fail until they're reopened
+        if (status[i] && !lost_ns[i]) {
+          err = status[i] < 0 ? -status[i] : ENODATA;
+          if (n == 1) {
+            fprintf(stderr, "Failed to get data from ODROID Smart Power: %s\n", strerror(err));
+          } else {
+            fprintf(stderr, "Failed to get data from ODROID Smart Power %zu: %s\n", i, strerror(err));
+          }
+        }
+      }
+    }
+    if (err) {
       failures++;
-      if (failures >= HOSP_MAX_FAILURES) {
-        ret = errno;
+      if (failures >= HOSP_MAX_FAILURES && reconnect) {
+        failures = 0;
+        retry_ns = now;
+        for (i = 0; i < n; i++) {
+          if (status[i] && !lost_ns[i]) {
+            fprintf(stderr, "Lost %s, waiting for it to reconnect...\n", device_label(n, i, label, sizeof(label)));
+            release_device(hosp_group_get_device(group, i), &hdevs[i]);
+            lost_ns[i] = now;
+            nlost++;
+            // bridge the gap when it's back, and don't compare its first reading to one from before
+            hosp_energy_gap(&energies[i]);
+            prevs[i].timestamp_ns = 0;
+          }
+        }
+      } else if (failures >= HOSP_MAX_FAILURES) {
+        ret = err;
         running = 0;
         fprintf(stderr, "Too many consecutive failures, exiting...\n");
       }
     } else {
-      // print data
-      printf("%u,%u,%u,%u\n", mV, mA, mW, mWh);
       failures = 0;
     }
+    for (i = 0; i < n; i++) {
+      dups[i] = 0;
+      if (status[i]) {
+        continue;
+      }
+      if (!prevs[i].timestamp_ns || !hosp_phase_is_duplicate(&prevs[i], &samples[i])) {
+        steady = 0;
+      } else if (sync_refresh && !steady && sync_probe(hosp_group_get_device(group, i), &phase, now, &samples[i])) {
+        // the refresh phase drifted, but now we have a fresh reading
+      } else {
+        // if syncing, probing didn't see a change within a refresh period, so the load is probably steady; don't
+        // probe again until the reading changes
+        steady = 1;
+        dups[i] = 1;
+        if (dedup == HOSP_DEDUP_SUPPRESS) {
+          status[i] = -EALREADY;
+        }
+      }
+      prevs[i] = samples[i];
+    }
+    busy_ns += hosp_time_ns() - now;
+    // emit the round, as long as at least one device succeeded (or all but suppressed duplicates failed), and when
+    // reconnecting, emit failed rounds with their fields empty to keep one round per period and mark any gap
+    emit = n > 1 || !err || reconnect;
+    if (dedup == HOSP_DEDUP_SUPPRESS) {
+      for (i = 0, emit = 0; i < n && !emit; i++) {
+        emit = !status[i] || lost_ns[i];
+      }
+    }
+    for (i = 0; i < n; i++) {
+      if (!status[i]) {
+        hosp_energy_update(&energies[i], &samples[i]);
+        if (windows != NULL) {
+          hosp_window_add(&windows[i], samples[i].mW);
+        }
+      }
+    }
+    if (windows != NULL) {
+      if ((now = hosp_time_ns()) >= window_deadline) {
+        print_window_row(&out, n, windows, energies);
+        for (i = 0; i < n; i++) {
+          hosp_window_reset(&windows[i], hosp_energy_get_uJ(&energies[i]));
+        }
+        // don't try to catch up on windows missed if sampling stalled
+        window_deadline += ((now - window_deadline) / window_ns + 1) * window_ns;
+      }
+    }
+    if (emit) {
+      emit_round(&out, server, windows == NULL, n, samples, status, energies, dups);
+    }
+    if (out.err) {
+      // the reason is reported on exit
+      running = 0;
+    }
+    if (stats_period_ns && hosp_time_ns() >= stats_deadline) {
+      print_stats(group, 0);
+      stats_deadline += stats_period_ns;
+    }
     if (running) {
-      // sleep for interval
-      hosp_util_msleep(interval_ms);
+      deadline += interval_ns;
+      if (sync_refresh) {
+        // follow any change to the refresh phase
+        deadline = hosp_phase_next(&phase, deadline - phase.period_ns / 2);
+      }
+      now = hosp_time_ns();
+      if (now > deadline) {
+        overruns++;
+        if (overrun_skip && interval_ns) {
+          missed = (now - deadline) / interval_ns + 1;
+          skipped += missed;
+          deadline += missed * interval_ns;
+        }
+      }
+      // sleep until the next period begins
+      hosp_time_sleep_until_ns(deadline);
+    }
+  }
+  if (windows != NULL) {
+    // print the last partial window, unless it's empty
+    for (i = 0; i < n; i++) {
+      if (windows[i].count) {
+        print_window_row(&out, n, windows, energies);
+        break;
+      }
+    }
+  }
+  dropped = hosp_writer_get_dropped(out.writer);
+  if ((err = hosp_writer_stop(out.writer)) && !out.err) {
+    out.err = err;
+  }
+  if (out.err && out.err != EPIPE) {
+    // like other tools, a closed pipe just means the consumer is done
+    ret = out.err;
+    fprintf(stderr, "Failed to write output: %s\n", strerror(out.err));
+  }
+  if (dropped) {
+    fprintf(stderr, "Output fell behind, dropped %"PRIu64" round(s)\n", dropped);
+  }
+  if (overruns) {
+    fprintf(stderr, "Sampling overran the interval %lu time(s), skipping %lu period(s)\n", overruns, skipped);
+  }
+  if (stats) {
+    print_stats(group, 1);
+    now = hosp_time_ns();
+    fprintf(stderr, "Time: total=%.3f s sampling=%.3f s (%.1f%%) idle=%.3f s\n",
+            (double) (now - start_ns) / HOSP_NS_PER_S, (double) busy_ns / HOSP_NS_PER_S,
+            now > start_ns ? 100.0 * (double) busy_ns / (double) (now - start_ns) : 0.0,
+            (double) (now - start_ns - busy_ns) / HOSP_NS_PER_S);
+    print_jitter(&jitter);
+    if (sync_refresh) {
+      fprintf(stderr, "Sync: refresh window=%.3f ms changes=%u\n", (double) (phase.hi - phase.lo) / HOSP_NS_PER_MS,
+              phase.changes);
+    }
+  }
+  if (energy) {
+    // cross-check the integrated energy against the device's counter
+    for (i = 0; i < n; i++) {
+      uJ = hosp_energy_get_uJ(&energies[i]);
+      counted_uJ = hosp_energy_get_device_mWh(&energies[i]) * HOSP_ENERGY_UJ_PER_MWH;
+      fprintf(stderr, "Device %zu: energy integrated=%.3f J counted=%.3f J counter_wraps=%"PRIu64
+              " counter_resets=%"PRIu64" gaps=%"PRIu64"\n", i, (double) uJ / 1000000, (double) counted_uJ / 1000000,
+              hosp_energy_get_wraps(&energies[i]), hosp_energy_get_resets(&energies[i]),
+              hosp_energy_get_gaps(&energies[i]));
+    }
+  }
+close_server:
+  if (server != NULL) {
+    if (hosp_server_get_dropped(server)) {
+      fprintf(stderr, "Dropped %lu slow subscriber(s)\n", hosp_server_get_dropped(server));
     }
+    hosp_server_close(server);
   }
+  if (hotplug != NULL) {
+    hosp_hotplug_close(hotplug);
+  }
+free_bufs:
+  free(windows);
+  free(out.buf);
+  free(lost_ns);
+  free(dups);
+  free(prevs);
+  free(energies);
+  free(status);
+  free(samples);
   return ret;
 }
 
 int main(int argc, char** argv) {
-  hid_device* hdev = NULL;
-  hosp_device* hosp;
-  int ret;
-
-  // Flushing lines improves streaming performance when stdout is non-interactive, e.g., piped to another process.
-  // This enables better (soft) real-time pipeline processing.
-  setlinebuf(stdout);
+  hid_device** hdevs;
+  hosp_device** hosps = NULL;
+  hosp_group* group;
+  size_t ndevs;
+  size_t i;
+  size_t j;
+  size_t k;
+  int ret = 0;
 
   signal(SIGINT, shandle);
   parse_args(argc, argv);
 
+  hosp_util_set_read_policy(timeout_ms, retries);
+
+  // without a path, we use the first device found
+  ndevs = npaths ? npaths : 1;
+  if ((hdevs = calloc(ndevs, sizeof(hid_device*))) == NULL || (hosps = calloc(ndevs, sizeof(hosp_device*))) == NULL ||
+      (identities = calloc(ndevs, sizeof(*identities))) == NULL) {
+    perror("calloc");
+    free(hosps);
+    free(hdevs);
+    free(paths);
+    return ENOMEM;
+  }
+
   if (hid_init() < 0) {
     fprintf(stderr, "hid_init: %ls\n", hid_error(NULL));
-    return 1;
+    ret = 1;
+    goto free_devs;
   }
 
-  if (path != NULL) {
-    if ((hdev = hid_open_path(path)) == NULL) {
-      fprintf(stderr, "%ls\n", hid_error(NULL));
+  for (i = 0; i < npaths; i++) {
+    if ((hdevs[i] = hid_open_path(paths[i])) == NULL) {
+      fprintf(stderr, "%s: %ls\n", paths[i], hid_error(NULL));
       ret = 1;
-      goto exit_hid;
+      goto close_hdevs;
+    }
+    // the path may change when the device is plugged back in
+    if (reconnect && hosp_hotplug_identify(paths[i], identities[i], sizeof(identities[i]))) {
+      fprintf(stderr, "%s: no USB port or serial number to find it by, will reopen the same path\n", paths[i]);
     }
   }
 
-  if ((hosp = hosp_open_device(hdev)) == NULL) {
-    perror("Failed to open ODROID Smart Power connection");
-    ret = errno;
-    goto close_hdev;
+  for (j = 0; j < ndevs; j++) {
+    if ((hosps[j] = hosp_open_device(hdevs[j])) == NULL) {
+      perror("Failed to open ODROID Smart Power connection");
+      ret = errno;
+      goto close_hosps;
+    }
+    if (hid_set_nonblocking(hosp_get_device(hosps[j]), 1) < 0) {
+      // Not a fatal error.
+      fprintf(stderr, "hid_set_nonblocking: %ls\n", hid_error(hosp_get_device(hosps[j])));
+    }
   }
 
-  if (hid_set_nonblocking(hosp_get_device(hosp), 1) < 0) {
-    // Not a fatal error.
-    fprintf(stderr, "hid_set_nonblocking: %ls\n", hid_error(hosp_get_device(hosp)));
+  if ((group = hosp_group_create(hosps, ndevs)) == NULL) {
+    perror("Failed to create ODROID Smart Power group");
+    ret = errno;
+    goto close_hosps;
   }
 
-  if (!restart || !(ret = hosp_restart(hosp))) {
-    ret = hosp_poll(hosp);
+  if (restart) {
+    for (k = 0; k < ndevs && !ret; k++) {
+      ret = hosp_util_restart(hosps[k]);
+    }
   }
-
-  if (hosp_close(hosp)) {
-    ret = errno;
-    perror("Failed to close ODROID Smart Power connection");
+  if (!ret) {
+    ret = hosp_poll(group, hdevs);
   }
 
-close_hdev:
-  if (hdev != NULL) {
-    hid_close(hdev);
+  hosp_group_close(group);
+
+close_hosps:
+  while (j-- > 0) {
+    if (hosp_close(hosps[j])) {
+      ret = errno;
+      perror("Failed to close ODROID Smart Power connection");
+    }
   }
 
-exit_hid:
+close_hdevs:
+  while (i-- > 0) {
+    if (hdevs[i] != NULL) {
+      hid_close(hdevs[i]);
+    }
+  }
   hid_exit();
+
+free_devs:
+  free(identities);
+  free(hosps);
+  free(hdevs);
+  free(paths);
   return ret;
 }
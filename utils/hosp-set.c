@@ -12,15 +12,22 @@
 #include <hosp.h>
 #include "util.h"
 
+// Time to wait after reading the status before writing a toggle request, and between toggle requests
+#define HOSP_TOGGLE_DELAY_MS 1
+
 static const char* path = NULL;
+static int timeout_ms = HOSP_READ_TIMEOUT_MS;
+static unsigned int retries = HOSP_READ_RETRIES;
 // -1 if unset, 0 for OFF/STOP, 1 for ON/START
 static int action_onoff = -1;
 static int action_startstop = -1;
 
-static const char short_options[] = "hp:o:s:";
+static const char short_options[] = "hp:o:s:t:R:";
 static const struct option long_options[] = {
   {"help",      no_argument,       NULL, 'h'},
   {"path",      required_argument, NULL, 'p'},
+  {"timeout",   required_argument, NULL, 't'},
+  {"retries",   required_argument, NULL, 'R'},
   {"onoff",     required_argument, NULL, 'o'},
   {"startstop", required_argument, NULL, 's'},
   {0, 0, 0, 0}
@@ -34,8 +41,11 @@ static void print_usage(int exit_code) {
           "Options:\n"
           "  -h, --help               Print this message and exit\n"
           "  -p, --path               Device path (defaults to the first Smart Power found)\n"
+          "  -t, --timeout=MS         Time to wait for a response, -1 to wait indefinitely (default=%d)\n"
+          "  -R, --retries=N          Number of times to resend a request that times out (default=%u)\n"
           "  -o, --onoff=1|0          Turn the device ON (1) or OFF (0)\n"
-          "  -s, --startstop=1|0      START (1) or STOP (0) the device\n");
+          "  -s, --startstop=1|0      START (1) or STOP (0) the device\n",
+          HOSP_READ_TIMEOUT_MS, HOSP_READ_RETRIES);
   exit(exit_code);
 }
 
@@ -49,6 +59,15 @@ static void parse_args(int argc, char** argv) {
       case 'p':
         path = optarg;
         break;
+      case 't':
+        if (hosp_util_parse_timeout(optarg, &timeout_ms)) {
+          fprintf(stderr, "Timeout must be an integer >= -1\n");
+          print_usage(EINVAL);
+        }
+        break;
+      case 'R':
+        retries = (unsigned int) strtoul(optarg, NULL, 0);
+        break;
       case 'o':
         action_onoff = atoi(optarg) ? 1 : 0;
         break;
@@ -79,7 +98,7 @@ static int hosp_set_status(hosp_device* hosp) {
   }
   if (action_onoff >= 0 && action_onoff != is_on) {
     // toggle ON/OFF
-    hosp_util_msleep(HOSP_WRITE_READ_DELAY_MS);
+    hosp_util_msleep(HOSP_TOGGLE_DELAY_MS);
     if (hosp_request_onoff_write(hosp)) {
       ret = errno;
       perror("Failed to toggle ON/OFF");
@@ -88,7 +107,7 @@ static int hosp_set_status(hosp_device* hosp) {
   }
   if (action_startstop >= 0 && action_startstop != is_started) {
     // toggle START/STOP
-    hosp_util_msleep(HOSP_WRITE_READ_DELAY_MS);
+    hosp_util_msleep(HOSP_TOGGLE_DELAY_MS);
     if (hosp_request_startstop_write(hosp)) {
       ret = errno;
       perror("Failed to toggle START/STOP");
@@ -104,6 +123,7 @@ int main(int argc, char** argv) {
   int ret;
 
   parse_args(argc, argv);
+  hosp_util_set_read_policy(timeout_ms, retries);
 
   if (hid_init() < 0) {
     fprintf(stderr, "hid_init: %ls\n", hid_error(NULL));
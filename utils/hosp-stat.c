@@ -0,0 +1,333 @@
+/**
+ * Run a command and report the energy it used, measured by an ODROID Smart Power.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <hidapi.h>
+#include <hosp.h>
+#include <hosp-sampler.h>
+#include "util.h"
+
+#define HOSP_STAT_DEFAULT_INTERVAL_MS 100
+// enough samples to find the peak power of runs up to 1 hour long at the default interval
+#define HOSP_STAT_CAPACITY 36000
+// give up if the sampler doesn't get a sample within this many intervals
+#define HOSP_STAT_FIRST_SAMPLE_INTERVALS 10
+
+// the measurements of each run
+enum {
+  HOSP_STAT_ENERGY,
+  HOSP_STAT_MEAN_POWER,
+  HOSP_STAT_PEAK_POWER,
+  HOSP_STAT_TIME,
+  HOSP_STAT_METRICS
+};
+
+static const char* const metric_units[HOSP_STAT_METRICS] = { "J", "W", "W", "s" };
+static const char* const metric_names[HOSP_STAT_METRICS] = { "energy", "mean power", "peak power", "time elapsed" };
+
+static const char* path = NULL;
+static int timeout_ms = HOSP_READ_TIMEOUT_MS;
+static unsigned int retries = HOSP_READ_RETRIES;
+static unsigned long interval_ms = HOSP_STAT_DEFAULT_INTERVAL_MS;
+static unsigned int repeat = 1;
+static int restart = 1;
+
+static const char short_options[] = "+hp:r:i:Nt:R:";
+static const struct option long_options[] = {
+  {"help",       no_argument,       NULL, 'h'},
+  {"path",       required_argument, NULL, 'p'},
+  {"repeat",     required_argument, NULL, 'r'},
+  {"interval",   required_argument, NULL, 'i'},
+  {"no-restart", no_argument,       NULL, 'N'},
+  {"timeout",    required_argument, NULL, 't'},
+  {"retries",    required_argument, NULL, 'R'},
+  {0, 0, 0, 0}
+};
+
+__attribute__ ((noreturn))
+static void print_usage(int exit_code) {
+  fprintf(exit_code ? stderr : stdout,
+          "Run a command and print the energy it used, measured by an ODROID Smart Power, to stderr.\n\n"
+          "Usage: hosp-stat [OPTION]... [--] COMMAND [ARG]...\n"
+          "Options:\n"
+          "  -h, --help               Print this message and exit\n"
+          "  -p, --path               Device path (defaults to the first Smart Power found)\n"
+          "  -r, --repeat=N           Run the command N times and report the mean and standard deviation (default=1)\n"
+          "  -i, --interval=MS        The sampling interval in milliseconds (default=%u)\n"
+          "  -N, --no-restart         Don't restart the Watt-hour counter before each run\n"
+          "  -t, --timeout=MS         Time to wait for a response, -1 to wait indefinitely (default=%d)\n"
+          "  -R, --retries=N          Number of times to resend a request that times out (default=%u)\n",
+          HOSP_STAT_DEFAULT_INTERVAL_MS, HOSP_READ_TIMEOUT_MS, HOSP_READ_RETRIES);
+  exit(exit_code);
+}
+
+static void parse_args(int argc, char** argv) {
+  int c;
+  while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+    switch (c) {
+      case 'h':
+        print_usage(0);
+        break;
+      case 'p':
+        path = optarg;
+        break;
+      case 'r':
+        repeat = (unsigned int) strtoul(optarg, NULL, 0);
+        break;
+      case 'i':
+        interval_ms = strtoul(optarg, NULL, 0);
+        break;
+      case 'N':
+        restart = 0;
+        break;
+      case 't':
+        if (hosp_util_parse_timeout(optarg, &timeout_ms)) {
+          fprintf(stderr, "Timeout must be an integer >= -1\n");
+          print_usage(EINVAL);
+        }
+        break;
+      case 'R':
+        retries = (unsigned int) strtoul(optarg, NULL, 0);
+        break;
+      case '?':
+      default:
+        print_usage(EINVAL);
+        break;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "No command specified\n");
+    print_usage(EINVAL);
+  }
+  if (!repeat || !interval_ms) {
+    fprintf(stderr, "Repeat count and interval must be > 0\n");
+    print_usage(EINVAL);
+  }
+}
+
+// Returns the child's wait status, or -1 on failure (prints)
+static int run_command(char** cmd) {
+  pid_t pid;
+  int status;
+  if ((pid = fork()) < 0) {
+    perror("fork");
+    return -1;
+  }
+  if (pid == 0) {
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    execvp(cmd[0], cmd);
+    fprintf(stderr, "%s: %s\n", cmd[0], strerror(errno));
+    _exit(127);
+  }
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      perror("waitpid");
+      return -1;
+    }
+  }
+  return status;
+}
+
+// Returns 0 on success, errno on failure (prints)
+static int wait_first_sample(const hosp_sampler* sampler) {
+  unsigned int i;
+  for (i = 0; i < HOSP_STAT_FIRST_SAMPLE_INTERVALS * 10; i++) {
+    if (hosp_sampler_get_seq(sampler)) {
+      return 0;
+    }
+    hosp_util_msleep(interval_ms / 10 + 1);
+  }
+  fprintf(stderr, "Failed to get data from ODROID Smart Power: %s\n", strerror(ENODATA));
+  return ENODATA;
+}
+
+// Returns the peak power in milliwatts of the samples from the cursor on
+static unsigned int get_peak_mW(hosp_sampler* sampler, uint64_t cursor) {
+  hosp_sample samples[64];
+  unsigned int peak = 0;
+  uint64_t expected = cursor;
+  size_t n;
+  size_t i;
+  while ((n = hosp_sampler_read(sampler, &cursor, samples, sizeof(samples) / sizeof(samples[0]))) > 0) {
+    if (cursor - n != expected) {
+      fprintf(stderr, "Warning: the run outlasted the sample buffer, peak power is only for the end of the run\n");
+    }
+    expected = cursor;
+    for (i = 0; i < n; i++) {
+      if (samples[i].mW > peak) {
+        peak = samples[i].mW;
+      }
+    }
+  }
+  return peak;
+}
+
+// Returns 0 on success, the child's exit code if it failed, or errno on other failures (prints)
+static int stat_run(hosp_device* hosp, char** cmd, double* run) {
+  hosp_sampler* sampler;
+  hosp_region region;
+  uint64_t cursor;
+  uint64_t uJ;
+  uint64_t ns;
+  unsigned int mW;
+  unsigned int peak_mW;
+  int status;
+  int ret;
+  if (restart && (ret = hosp_util_restart(hosp))) {
+    return ret;
+  }
+  if ((sampler = hosp_sampler_start(hosp, interval_ms, HOSP_STAT_CAPACITY)) == NULL) {
+    ret = errno;
+    perror("Failed to start sampling ODROID Smart Power");
+    return ret;
+  }
+  if ((ret = wait_first_sample(sampler))) {
+    hosp_sampler_stop(sampler);
+    return ret;
+  }
+  // the sample the region begins with bounds the peak too
+  cursor = hosp_sampler_get_seq(sampler) - 1;
+  hosp_region_begin(sampler, &region);
+  status = run_command(cmd);
+  hosp_region_end(sampler, &region, &uJ, &ns, &mW);
+  if (hosp_sampler_get_seq(sampler) - 1 == cursor) {
+    // the run was shorter than the sampling interval, so there's only the sample from before it
+    peak_mW = mW;
+  } else {
+    peak_mW = get_peak_mW(sampler, cursor);
+  }
+  if (hosp_sampler_stop(sampler)) {
+    perror("Failed to stop sampling ODROID Smart Power");
+  }
+  if (status < 0) {
+    return ECHILD;
+  }
+  if (WIFSIGNALED(status)) {
+    fprintf(stderr, "%s: terminated by signal %d\n", cmd[0], WTERMSIG(status));
+    return 128 + WTERMSIG(status);
+  }
+  if (WEXITSTATUS(status)) {
+    fprintf(stderr, "%s: exited with status %d\n", cmd[0], WEXITSTATUS(status));
+    return WEXITSTATUS(status);
+  }
+  run[HOSP_STAT_ENERGY] = (double) uJ / 1000000.0;
+  run[HOSP_STAT_MEAN_POWER] = (double) mW / 1000.0;
+  run[HOSP_STAT_PEAK_POWER] = (double) peak_mW / 1000.0;
+  run[HOSP_STAT_TIME] = (double) ns / 1000000000.0;
+  return 0;
+}
+
+static void print_stats(char** cmd, const double (*runs)[HOSP_STAT_METRICS], unsigned int n) {
+  char** arg;
+  double mean;
+  double var;
+  double x;
+  unsigned int i;
+  unsigned int m;
+  fprintf(stderr, "\n Energy stats for '");
+  for (arg = cmd; *arg != NULL; arg++) {
+    fprintf(stderr, "%s%s", arg == cmd ? "" : " ", *arg);
+  }
+  if (n > 1) {
+    fprintf(stderr, "' (%u runs):\n\n", n);
+  } else {
+    fprintf(stderr, "':\n\n");
+  }
+  for (m = 0; m < HOSP_STAT_METRICS; m++) {
+    mean = 0;
+    for (i = 0; i < n; i++) {
+      mean += runs[i][m];
+    }
+    mean /= n;
+    if (n == 1) {
+      fprintf(stderr, "%18.6f %-2s %s\n", mean, metric_units[m], metric_names[m]);
+      continue;
+    }
+    var = 0;
+    for (i = 0; i < n; i++) {
+      x = runs[i][m] - mean;
+      var += x * x;
+    }
+    // sample standard deviation
+    fprintf(stderr, "%18.6f %-2s %-14s ( +- %.6f )\n", mean, metric_units[m], metric_names[m], sqrt(var / (n - 1)));
+  }
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+  hid_device* hdev = NULL;
+  hosp_device* hosp;
+  double (*runs)[HOSP_STAT_METRICS];
+  char** cmd;
+  unsigned int i;
+  int ret = 0;
+
+  parse_args(argc, argv);
+  cmd = &argv[optind];
+  hosp_util_set_read_policy(timeout_ms, retries);
+  if ((runs = calloc(repeat, sizeof(*runs))) == NULL) {
+    perror("calloc");
+    return ENOMEM;
+  }
+
+  if (hid_init() < 0) {
+    fprintf(stderr, "hid_init: %ls\n", hid_error(NULL));
+    ret = 1;
+    goto free_runs;
+  }
+
+  if (path != NULL) {
+    if ((hdev = hid_open_path(path)) == NULL) {
+      fprintf(stderr, "%s: %ls\n", path, hid_error(NULL));
+      ret = 1;
+      goto exit_hid;
+    }
+  }
+
+  if ((hosp = hosp_open_device(hdev)) == NULL) {
+    perror("Failed to open ODROID Smart Power connection");
+    ret = errno;
+    goto close_hdev;
+  }
+
+  // like the shell, let the command handle interrupts and report how it exited
+  signal(SIGINT, SIG_IGN);
+  signal(SIGQUIT, SIG_IGN);
+  for (i = 0; i < repeat && !ret; i++) {
+    ret = stat_run(hosp, cmd, runs[i]);
+  }
+  signal(SIGINT, SIG_DFL);
+  signal(SIGQUIT, SIG_DFL);
+  if (i > 1 || !ret) {
+    // report the successful runs, if any
+    print_stats(cmd, (const double (*)[HOSP_STAT_METRICS]) runs, ret ? i - 1 : i);
+  }
+
+  if (hosp_close(hosp)) {
+    ret = errno;
+    perror("Failed to close ODROID Smart Power connection");
+  }
+
+close_hdev:
+  if (hdev != NULL) {
+    hid_close(hdev);
+  }
+
+exit_hid:
+  hid_exit();
+
+free_runs:
+  free(runs);
+  return ret;
+}
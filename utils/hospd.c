@@ -0,0 +1,214 @@
+/**
+ * Own an ODROID Smart Power and publish its samples to shared memory for any number of local readers.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <hidapi.h>
+#include <hosp.h>
+#include <hosp-shm.h>
+#include "hosp-time.h"
+#include "util.h"
+
+#define HOSPD_DEFAULT_INTERVAL_MS 100
+#define HOSPD_DEFAULT_CAPACITY 600
+// the longest interval that fits in interval_ms, and in nanoseconds
+#define HOSPD_INTERVAL_MS_MAX (ULONG_MAX < HOSP_UTIL_MS_MAX ? ULONG_MAX : HOSP_UTIL_MS_MAX)
+
+static const char* path = NULL;
+static const char* name = HOSP_SHM_DEFAULT_NAME;
+static int timeout_ms = HOSP_READ_TIMEOUT_MS;
+static unsigned int retries = HOSP_READ_RETRIES;
+static unsigned long interval_ms = HOSPD_DEFAULT_INTERVAL_MS;
+static size_t capacity = HOSPD_DEFAULT_CAPACITY;
+static volatile sig_atomic_t running = 1;
+
+static const char short_options[] = "hp:n:i:c:t:R:";
+static const struct option long_options[] = {
+  {"help",      no_argument,       NULL, 'h'},
+  {"path",      required_argument, NULL, 'p'},
+  {"name",      required_argument, NULL, 'n'},
+  {"interval",  required_argument, NULL, 'i'},
+  {"capacity",  required_argument, NULL, 'c'},
+  {"timeout",   required_argument, NULL, 't'},
+  {"retries",   required_argument, NULL, 'R'},
+  {0, 0, 0, 0}
+};
+
+__attribute__ ((noreturn))
+static void print_usage(int exit_code) {
+  fprintf(exit_code ? stderr : stdout,
+          "Poll an ODROID Smart Power continuously and publish samples to POSIX shared memory (see hosp-shm.h).\n"
+          "Runs in the foreground until interrupted or terminated.\n\n"
+          "Usage: hospd [OPTION]...\n"
+          "Options:\n"
+          "  -h, --help               Print this message and exit\n"
+          "  -p, --path               Device path (defaults to the first Smart Power found)\n"
+          "  -n, --name=NAME          The shared memory object name (default=%s)\n"
+          "  -i, --interval=MS        The polling interval in milliseconds (default=%u)\n"
+          "  -c, --capacity=N         The number of recent samples to retain (default=%u)\n"
+          "  -t, --timeout=MS         Time to wait for a response, -1 to wait indefinitely (default=%d)\n"
+          "  -R, --retries=N          Number of times to resend a request that times out (default=%u)\n",
+          HOSP_SHM_DEFAULT_NAME, HOSPD_DEFAULT_INTERVAL_MS, HOSPD_DEFAULT_CAPACITY, HOSP_READ_TIMEOUT_MS,
+          HOSP_READ_RETRIES);
+  exit(exit_code);
+}
+
+static void parse_args(int argc, char** argv) {
+  uint64_t val;
+  int c;
+  while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+    switch (c) {
+      case 'h':
+        print_usage(0);
+        break;
+      case 'p':
+        path = optarg;
+        break;
+      case 'n':
+        name = optarg;
+        break;
+      case 'i':
+        if (hosp_util_parse_u64(optarg, 1, HOSPD_INTERVAL_MS_MAX, &val)) {
+          fprintf(stderr, "Interval must be an integer from 1 to %" PRIu64 "\n", (uint64_t) HOSPD_INTERVAL_MS_MAX);
+          print_usage(EINVAL);
+        }
+        interval_ms = (unsigned long) val;
+        break;
+      case 'c':
+        if (hosp_util_parse_u64(optarg, 1, SIZE_MAX, &val)) {
+          fprintf(stderr, "Capacity must be an integer > 0\n");
+          print_usage(EINVAL);
+        }
+        capacity = (size_t) val;
+        break;
+      case 't':
+        if (hosp_util_parse_timeout(optarg, &timeout_ms)) {
+          fprintf(stderr, "Timeout must be an integer >= -1\n");
+          print_usage(EINVAL);
+        }
+        break;
+      case 'R':
+        if (hosp_util_parse_u64(optarg, 0, UINT_MAX, &val)) {
+          fprintf(stderr, "Retries must be an integer >= 0\n");
+          print_usage(EINVAL);
+        }
+        retries = (unsigned int) val;
+        break;
+      case '?':
+      default:
+        print_usage(EINVAL);
+        break;
+    }
+  }
+}
+
+static void shandle(int sig) {
+  switch (sig) {
+    case SIGTERM:
+    case SIGINT:
+#ifdef SIGHUP
+    case SIGHUP:
+#endif
+      running = 0;
+    default:
+      break;
+  }
+}
+
+static void hospd_run(hosp_device* hosp, hosp_shm* shm) {
+  hosp_sample s;
+  uint64_t interval_ns = interval_ms * HOSP_NS_PER_MS;
+  uint64_t deadline = hosp_time_ns();
+  int failing = 0;
+  while (running) {
+    if (hosp_util_get_data(hosp, &s.mV, &s.mA, &s.mW, &s.mWh)) {
+      // only report transitions so a missing device doesn't flood the log
+      if (!failing) {
+        perror("Failed to get data from ODROID Smart Power");
+        failing = 1;
+      }
+    } else {
+      s.timestamp_ns = hosp_time_ns();
+      hosp_shm_publish(shm, &s);
+      if (failing) {
+        fprintf(stderr, "Getting data from ODROID Smart Power again\n");
+        failing = 0;
+      }
+    }
+    deadline = hosp_time_sleep_period_ns(deadline, interval_ns);
+  }
+}
+
+int main(int argc, char** argv) {
+  hid_device* hdev = NULL;
+  hosp_device* hosp;
+  hosp_shm* shm;
+  int ret = 0;
+
+  parse_args(argc, argv);
+  hosp_util_set_read_policy(timeout_ms, retries);
+  signal(SIGINT, shandle);
+  signal(SIGTERM, shandle);
+#ifdef SIGHUP
+  signal(SIGHUP, shandle);
+#endif
+
+  if (hid_init() < 0) {
+    fprintf(stderr, "hid_init: %ls\n", hid_error(NULL));
+    return 1;
+  }
+
+  if (path != NULL) {
+    if ((hdev = hid_open_path(path)) == NULL) {
+      fprintf(stderr, "%s: %ls\n", path, hid_error(NULL));
+      ret = 1;
+      goto exit_hid;
+    }
+  }
+
+  if ((hosp = hosp_open_device(hdev)) == NULL) {
+    perror("Failed to open ODROID Smart Power connection");
+    ret = errno;
+    goto close_hdev;
+  }
+
+  if (hid_set_nonblocking(hosp_get_device(hosp), 1) < 0) {
+    // Not a fatal error.
+    fprintf(stderr, "hid_set_nonblocking: %ls\n", hid_error(hosp_get_device(hosp)));
+  }
+
+  if ((shm = hosp_shm_create(name, capacity, interval_ms)) == NULL) {
+    ret = errno;
+    fprintf(stderr, "Failed to create shared memory %s: %s\n", name, strerror(ret));
+    goto close_hosp;
+  }
+
+  hospd_run(hosp, shm);
+
+  if (hosp_shm_close(shm)) {
+    ret = errno;
+    perror("Failed to close shared memory");
+  }
+
+close_hosp:
+  if (hosp_close(hosp)) {
+    ret = errno;
+    perror("Failed to close ODROID Smart Power connection");
+  }
+
+close_hdev:
+  if (hdev != NULL) {
+    hid_close(hdev);
+  }
+
+exit_hid:
+  hid_exit();
+  return ret;
+}
@@ -0,0 +1,171 @@
+/**
+ * Notice devices being plugged in, using kernel uevents over netlink on Linux.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <hidapi.h>
+#include <hosp.h>
+#include "hotplug.h"
+
+// uevents are a header like "add@/devices/..." followed by NUL-separated KEY=VALUE pairs
+#define HOSP_HOTPLUG_BUF_SIZE 4096
+
+struct hosp_hotplug {
+  int fd;
+};
+
+#if defined(__linux__)
+// Returns 1 if the uevent is for a USB or hidraw device being added
+static int hosp_hotplug_is_add(const char* buf, size_t len) {
+  const char* key;
+  if (len < 4 || memcmp(buf, "add@", 4)) {
+    return 0;
+  }
+  for (key = buf; key < buf + len; key += strlen(key) + 1) {
+    if (!strcmp(key, "SUBSYSTEM=usb") || !strcmp(key, "SUBSYSTEM=hidraw")) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+hosp_hotplug* hosp_hotplug_open(void) {
+#if defined(__linux__)
+  hosp_hotplug* hotplug;
+  struct sockaddr_nl addr;
+  int err;
+  if ((hotplug = malloc(sizeof(hosp_hotplug))) == NULL) {
+    return NULL;
+  }
+  if ((hotplug->fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT)) < 0) {
+    err = errno;
+    free(hotplug);
+    errno = err;
+    return NULL;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  // the kernel's multicast group, rather than udev's
+  addr.nl_groups = 1;
+  if (bind(hotplug->fd, (struct sockaddr*) &addr, sizeof(addr))) {
+    err = errno;
+    hosp_hotplug_close(hotplug);
+    errno = err;
+    return NULL;
+  }
+  return hotplug;
+#else
+  errno = ENOTSUP;
+  return NULL;
+#endif
+}
+
+void hosp_hotplug_close(hosp_hotplug* hotplug) {
+#if defined(__linux__)
+  close(hotplug->fd);
+#endif
+  free(hotplug);
+}
+
+int hosp_hotplug_check(hosp_hotplug* hotplug) {
+  int ret = 0;
+#if defined(__linux__)
+  char buf[HOSP_HOTPLUG_BUF_SIZE];
+  ssize_t len;
+  // drain all pending events
+  while ((len = recv(hotplug->fd, buf, sizeof(buf) - 1, 0)) >= 0 || errno == EINTR) {
+    if (len > 0) {
+      buf[len] = '\0';
+      ret |= hosp_hotplug_is_add(buf, (size_t) len);
+    }
+  }
+#else
+  (void) hotplug;
+#endif
+  return ret;
+}
+
+#if defined(__linux__)
+// Get the USB port a hidraw node's device is plugged into, e.g., "1-2.4" from its interface's sysfs directory, like
+// "/sys/devices/.../usb1/1-2/1-2.4/1-2.4:1.0/0003:04D8:003F.0001"; returns 0 on success
+static int hosp_hotplug_get_usb_port(const char* path, char* port, size_t len) {
+  char sys[PATH_MAX];
+  char real[PATH_MAX];
+  char* iface;
+  char* colon;
+  if (strncmp(path, "/dev/hidraw", sizeof("/dev/hidraw") - 1) ||
+      snprintf(sys, sizeof(sys), "/sys/class/hidraw/%s/device", path + sizeof("/dev/") - 1) >= (int) sizeof(sys) ||
+      realpath(sys, real) == NULL || (iface = strrchr(real, '/')) == NULL) {
+    return -1;
+  }
+  *iface = '\0';
+  if ((iface = strrchr(real, '/')) == NULL || (colon = strchr(++iface, ':')) == NULL) {
+    return -1;
+  }
+  *colon = '\0';
+  return snprintf(port, len, "%s", iface) >= (int) len;
+}
+#endif
+
+// Get an enumerated device's identity; returns 0 on success, ENOENT if it has none
+static int hosp_hotplug_get_identity(const struct hid_device_info* info, char* identity, size_t len) {
+  int ret;
+#if defined(__linux__)
+  char port[HOSP_HOTPLUG_IDENTITY_LEN];
+  if (!hosp_hotplug_get_usb_port(info->path, port, sizeof(port))) {
+    ret = snprintf(identity, len, "usb:%s", port);
+    return ret < 0 || ret >= (int) len ? ENOENT : 0;
+  }
+#endif
+  if (info->serial_number == NULL || info->serial_number[0] == L'\0') {
+    return ENOENT;
+  }
+  ret = snprintf(identity, len, "serial:%ls", info->serial_number);
+  return ret < 0 || ret >= (int) len ? ENOENT : 0;
+}
+
+int hosp_hotplug_identify(const char* path, char* identity, size_t len) {
+  struct hid_device_info* infos = hosp_enumerate();
+  struct hid_device_info* info;
+  int ret = ENOENT;
+  for (info = infos; info != NULL; info = info->next) {
+    if (!strcmp(info->path, path)) {
+      ret = hosp_hotplug_get_identity(info, identity, len);
+      break;
+    }
+  }
+  hid_free_enumeration(infos);
+  return ret;
+}
+
+hid_device* hosp_hotplug_open_identity(const char* identity) {
+  char buf[HOSP_HOTPLUG_IDENTITY_LEN];
+  struct hid_device_info* infos = hosp_enumerate();
+  struct hid_device_info* info;
+  hid_device* dev = NULL;
+  int err = ENOENT;
+  for (info = infos; info != NULL; info = info->next) {
+    if (!hosp_hotplug_get_identity(info, buf, sizeof(buf)) && !strcmp(buf, identity)) {
+      errno = 0;
+      if ((dev = hid_open_path(info->path)) == NULL) {
+        // HIDAPI not guaranteed to set errno
+        err = errno ? errno : EIO;
+      }
+      break;
+    }
+  }
+  hid_free_enumeration(infos);
+  if (dev == NULL) {
+    errno = err;
+  }
+  return dev;
+}
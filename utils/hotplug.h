@@ -0,0 +1,49 @@
+/**
+ * Notice devices being plugged in, using kernel uevents over netlink on Linux.
+ *
+ * There's no dependency on libudev: the kernel broadcasts an "add" event for each new USB and hidraw device, which is
+ * enough to know when it's worth trying to reopen a lost device.
+ * On other platforms, or if the socket can't be opened, users fall back to retrying periodically.
+ *
+ * A device that's plugged back in may not get its old path, e.g., a hidraw node stays reserved while a handle to the
+ * lost device is open, so devices are found again by an identity that doesn't change instead.
+ */
+#ifndef _HOSP_HOTPLUG_H_
+#define _HOSP_HOTPLUG_H_
+
+#include <stddef.h>
+#include <hidapi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Enough for "usb:" and a USB port path, or "serial:" and a serial number
+#define HOSP_HOTPLUG_IDENTITY_LEN 128
+
+#pragma GCC visibility push(hidden)
+
+typedef struct hosp_hotplug hosp_hotplug;
+
+// Start listening for devices being plugged in; returns NULL on failure or if unsupported (sets errno)
+hosp_hotplug* hosp_hotplug_open(void);
+
+void hosp_hotplug_close(hosp_hotplug* hotplug);
+
+// Returns 1 if a USB or hidraw device was plugged in since the last check, 0 otherwise, without blocking
+int hosp_hotplug_check(hosp_hotplug* hotplug);
+
+// Get the identity of the device at a path, while it's plugged in: the USB port it's plugged into with hidraw on Linux,
+// otherwise its serial number; returns 0 on success, ENOENT if it wasn't found or has no identity
+int hosp_hotplug_identify(const char* path, char* identity, size_t len);
+
+// Open the device with an identity; returns NULL on failure (sets errno, ENOENT if it isn't plugged in)
+hid_device* hosp_hotplug_open_identity(const char* identity);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * Sampling interval jitter statistics for utilities.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "jitter.h"
+
+void hosp_jitter_init(hosp_jitter* jitter, uint64_t nominal_ns) {
+  memset(jitter, 0, sizeof(*jitter));
+  jitter->nominal_ns = nominal_ns;
+  jitter->min_ns = UINT64_MAX;
+}
+
+static unsigned int hosp_jitter_bucket(uint64_t deviation_ns) {
+  uint64_t us = deviation_ns / 1000;
+  unsigned int bucket;
+  if (!us) {
+    return 0;
+  }
+  bucket = 64 - (unsigned int) __builtin_clzll(us);
+  return bucket < HOSP_JITTER_BUCKETS ? bucket : HOSP_JITTER_BUCKETS - 1;
+}
+
+void hosp_jitter_add(hosp_jitter* jitter, uint64_t ns) {
+  uint64_t interval_ns;
+  double delta;
+  if (jitter->last_ns && ns >= jitter->last_ns) {
+    interval_ns = ns - jitter->last_ns;
+    if (interval_ns < jitter->min_ns) {
+      jitter->min_ns = interval_ns;
+    }
+    if (interval_ns > jitter->max_ns) {
+      jitter->max_ns = interval_ns;
+    }
+    jitter->count++;
+    delta = (double) interval_ns - jitter->mean_ns;
+    jitter->mean_ns += delta / (double) jitter->count;
+    jitter->m2 += delta * ((double) interval_ns - jitter->mean_ns);
+    jitter->buckets[hosp_jitter_bucket(interval_ns > jitter->nominal_ns ? interval_ns - jitter->nominal_ns :
+                                                                          jitter->nominal_ns - interval_ns)]++;
+  }
+  jitter->last_ns = ns;
+}
+
+void hosp_jitter_skip(hosp_jitter* jitter) {
+  jitter->last_ns = 0;
+}
+
+double hosp_jitter_stddev_ns(const hosp_jitter* jitter) {
+  return jitter->count > 1 ? sqrt(jitter->m2 / (double) (jitter->count - 1)) : 0;
+}
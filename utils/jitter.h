@@ -0,0 +1,50 @@
+/**
+ * Sampling interval jitter statistics for utilities.
+ *
+ * Tracks the minimum, maximum, mean, and standard deviation (using Welford's online algorithm) of the intervals
+ * between samples, and a log-scale histogram of how far each interval deviates from the nominal one: bucket 0 counts
+ * deviations under 1 microsecond, bucket i > 0 counts deviations within [2^(i-1), 2^i) microseconds, and the last
+ * bucket also counts anything larger.
+ */
+#ifndef _HOSP_JITTER_H_
+#define _HOSP_JITTER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#pragma GCC visibility push(hidden)
+
+#define HOSP_JITTER_BUCKETS 32
+
+typedef struct hosp_jitter {
+  uint64_t nominal_ns;
+  // the start of the previous interval, or 0 before the first sample
+  uint64_t last_ns;
+  uint64_t count;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  double mean_ns;
+  double m2;
+  uint64_t buckets[HOSP_JITTER_BUCKETS];
+} hosp_jitter;
+
+void hosp_jitter_init(hosp_jitter* jitter, uint64_t nominal_ns);
+
+// Record that a sample started at a time, which ends the interval since the previous one
+void hosp_jitter_add(hosp_jitter* jitter, uint64_t ns);
+
+// Forget the previous sample time, so the next sample doesn't end an interval, e.g., after sampling was paused
+void hosp_jitter_skip(hosp_jitter* jitter);
+
+double hosp_jitter_stddev_ns(const hosp_jitter* jitter);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * Estimate the phase of an ODROID Smart Power's measurement refresh, for utilities.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <hosp.h>
+#include "phase.h"
+
+// how long after the end of the refresh window to write requests, for scheduling jitter
+#define HOSP_PHASE_GUARD_NS 1000000
+
+void hosp_phase_init(hosp_phase* phase, uint64_t period_ns) {
+  memset(phase, 0, sizeof(*phase));
+  phase->period_ns = period_ns;
+}
+
+void hosp_phase_add_change(hosp_phase* phase, uint64_t write_ns, uint64_t read_ns) {
+  uint64_t shift;
+  if (phase->changes++ && write_ns >= phase->lo) {
+    // move the new window back by whole periods to overlap the current one
+    shift = (write_ns - phase->lo + phase->period_ns / 2) / phase->period_ns * phase->period_ns;
+    write_ns -= shift;
+    read_ns -= shift;
+    if (write_ns < phase->hi && read_ns > phase->lo) {
+      phase->lo = write_ns > phase->lo ? write_ns : phase->lo;
+      phase->hi = read_ns < phase->hi ? read_ns : phase->hi;
+      return;
+    }
+    // no overlap, so the phase drifted or the device was reset; start over from the new window
+    write_ns += shift;
+    read_ns += shift;
+  }
+  phase->lo = write_ns;
+  phase->hi = read_ns;
+}
+
+uint64_t hosp_phase_next(const hosp_phase* phase, uint64_t now_ns) {
+  uint64_t t = phase->hi + HOSP_PHASE_GUARD_NS;
+  if (now_ns > t) {
+    t += (now_ns - t + phase->period_ns - 1) / phase->period_ns * phase->period_ns;
+  }
+  return t;
+}
+
+int hosp_phase_is_duplicate(const hosp_sample* prev, const hosp_sample* s) {
+  return prev->mV == s->mV && prev->mA == s->mA && prev->mW == s->mW && prev->mWh == s->mWh;
+}
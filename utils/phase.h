@@ -0,0 +1,49 @@
+/**
+ * Estimate the phase of an ODROID Smart Power's measurement refresh, for utilities.
+ *
+ * A device's readings only change when it refreshes its measurements (every 100 ms), so a change between two readings
+ * means a refresh happened after the earlier request was written and before the later reply was read.
+ * Intersecting these windows, modulo the refresh period, narrows down when refreshes happen.
+ * A request written after the end of the window is serviced after a refresh.
+ */
+#ifndef _HOSP_PHASE_H_
+#define _HOSP_PHASE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <hosp.h>
+
+#pragma GCC visibility push(hidden)
+
+#define HOSP_REFRESH_MS 100
+
+typedef struct hosp_phase {
+  uint64_t period_ns;
+  // a refresh happened in (lo, hi]
+  uint64_t lo;
+  uint64_t hi;
+  // number of changes observed
+  unsigned int changes;
+} hosp_phase;
+
+void hosp_phase_init(hosp_phase* phase, uint64_t period_ns);
+
+// Record a change between a reading requested at write_ns and the next reading, read at read_ns
+void hosp_phase_add_change(hosp_phase* phase, uint64_t write_ns, uint64_t read_ns);
+
+// Get the first time at or after now_ns that's just after a refresh, at which to write a request (requires changes > 0)
+uint64_t hosp_phase_next(const hosp_phase* phase, uint64_t now_ns);
+
+// Returns 1 if a reading is the same as the previous one, i.e., the device probably hasn't refreshed since
+int hosp_phase_is_duplicate(const hosp_sample* prev, const hosp_sample* s);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * Protect a utility's sampling thread from the system it's measuring.
+ */
+#if defined(__linux__)
+// for CPU affinity
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include "rt.h"
+
+int hosp_rt_set_cpu(int cpu) {
+#if defined(__linux__)
+  cpu_set_t set;
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return EINVAL;
+  }
+  CPU_ZERO(&set);
+  CPU_SET((size_t) cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void) cpu;
+  return ENOTSUP;
+#endif
+}
+
+int hosp_rt_set_sched(int policy, int priority) {
+  struct sched_param param = { 0 };
+  param.sched_priority = priority;
+  return pthread_setschedparam(pthread_self(), policy, &param);
+}
+
+// Touch each page of a stack frame so it's resident (and locked) before it's needed
+static __attribute__ ((noinline)) void hosp_rt_prefault_stack(void) {
+  volatile unsigned char buf[HOSP_RT_STACK_PREFAULT];
+  size_t i;
+  for (i = 0; i < sizeof(buf); i += 1024) {
+    buf[i] = 0;
+  }
+}
+
+int hosp_rt_lock_memory(void) {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+    return errno;
+  }
+  hosp_rt_prefault_stack();
+  return 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * Protect a utility's sampling thread from the system it's measuring, with CPU pinning, real-time scheduling, and
+ * locked memory.
+ *
+ * A heavily loaded host can preempt or page out a sampler for long enough to distort the interval between samples.
+ * Scheduling and affinity apply to the calling thread only, so threads started earlier, e.g., an output writer, keep
+ * running normally.
+ */
+#ifndef _HOSP_RT_H_
+#define _HOSP_RT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma GCC visibility push(hidden)
+
+// how much of the stack to fault in before locking memory, so the sampler doesn't page fault while it grows
+#define HOSP_RT_STACK_PREFAULT (256 * 1024)
+
+// Pin the calling thread to a CPU; returns 0 on success, or errno on failure (ENOTSUP if unsupported)
+int hosp_rt_set_cpu(int cpu);
+
+// Set the calling thread's scheduling policy, e.g., SCHED_FIFO or SCHED_RR, and priority; returns 0 on success, or
+// errno on failure (EPERM without privileges)
+int hosp_rt_set_sched(int policy, int priority);
+
+// Lock the process's current and future memory, and fault in the calling thread's stack; returns 0 on success, or
+// errno on failure
+int hosp_rt_lock_memory(void);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,289 @@
+/**
+ * A Unix domain socket server that streams poll rounds to subscribers, with history replay.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <hosp.h>
+#include <hosp-log.h>
+#include "server.h"
+
+#define HOSP_SERVER_MAX_CLIENTS 64
+#define HOSP_SERVER_LISTEN_BACKLOG 16
+// per-subscriber send buffer size, which bounds both memory use and frame size
+#define HOSP_SERVER_BUF_SIZE 65536
+#define HOSP_SERVER_FRAME_HEADER_SIZE 20
+#define HOSP_SERVER_REQUEST_SIZE 8
+
+#ifdef MSG_NOSIGNAL
+  #define HOSP_SERVER_SEND_FLAGS MSG_NOSIGNAL
+#else
+  // SO_NOSIGPIPE is set on the socket instead
+  #define HOSP_SERVER_SEND_FLAGS 0
+#endif
+
+struct hosp_server_client {
+  // -1 if the slot is unused
+  int fd;
+  int is_subscribed;
+  unsigned char req[HOSP_SERVER_REQUEST_SIZE];
+  size_t req_len;
+  // sequence number of the next round to send
+  uint64_t cursor;
+  unsigned char* out;
+  size_t out_off;
+  size_t out_len;
+};
+
+struct hosp_server {
+  int fd;
+  char* path;
+  size_t num_devices;
+  size_t record_size;
+  // encoded rounds, a ring of backlog records
+  unsigned char* records;
+  size_t backlog;
+  // sequence number of the next round
+  uint64_t head;
+  unsigned long dropped;
+  struct hosp_server_client clients[HOSP_SERVER_MAX_CLIENTS];
+};
+
+static void hosp_server_put_u32(unsigned char* buf, uint32_t val) {
+  buf[0] = (unsigned char) val;
+  buf[1] = (unsigned char) (val >> 8);
+  buf[2] = (unsigned char) (val >> 16);
+  buf[3] = (unsigned char) (val >> 24);
+}
+
+static void hosp_server_put_u64(unsigned char* buf, uint64_t val) {
+  hosp_server_put_u32(buf, (uint32_t) val);
+  hosp_server_put_u32(buf + 4, (uint32_t) (val >> 32));
+}
+
+static uint64_t hosp_server_get_u64(const unsigned char* buf) {
+  uint64_t val = 0;
+  int i;
+  for (i = 7; i >= 0; i--) {
+    val = val << 8 | buf[i];
+  }
+  return val;
+}
+
+static int hosp_server_set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+hosp_server* hosp_server_open(const char* path, size_t num_devices, size_t backlog) {
+  hosp_server* server;
+  struct sockaddr_un addr;
+  size_t i;
+  int err;
+  if (!num_devices || !backlog ||
+      HOSP_SERVER_FRAME_HEADER_SIZE + HOSP_LOG_RECORD_SIZE(num_devices) > HOSP_SERVER_BUF_SIZE ||
+      backlog > SIZE_MAX / HOSP_LOG_RECORD_SIZE(num_devices)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+  if ((server = calloc(1, sizeof(hosp_server))) == NULL) {
+    return NULL;
+  }
+  server->fd = -1;
+  for (i = 0; i < HOSP_SERVER_MAX_CLIENTS; i++) {
+    server->clients[i].fd = -1;
+  }
+  server->num_devices = num_devices;
+  server->record_size = HOSP_LOG_RECORD_SIZE(num_devices);
+  server->backlog = backlog;
+  if ((server->records = malloc(backlog * server->record_size)) == NULL ||
+      (server->path = strdup(path)) == NULL ||
+      (server->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      hosp_server_set_nonblocking(server->fd)) {
+    goto fail;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path, strlen(path));
+  // replace a socket left behind by a previous server
+  unlink(path);
+  if (bind(server->fd, (struct sockaddr*) &addr, sizeof(addr)) ||
+      listen(server->fd, HOSP_SERVER_LISTEN_BACKLOG)) {
+    goto fail;
+  }
+  return server;
+
+fail:
+  err = errno;
+  if (server->fd >= 0) {
+    close(server->fd);
+  }
+  free(server->path);
+  free(server->records);
+  free(server);
+  errno = err;
+  return NULL;
+}
+
+static void hosp_server_disconnect(struct hosp_server_client* client) {
+  close(client->fd);
+  free(client->out);
+  memset(client, 0, sizeof(*client));
+  client->fd = -1;
+}
+
+void hosp_server_close(hosp_server* server) {
+  size_t i;
+  for (i = 0; i < HOSP_SERVER_MAX_CLIENTS; i++) {
+    if (server->clients[i].fd >= 0) {
+      hosp_server_disconnect(&server->clients[i]);
+    }
+  }
+  close(server->fd);
+  unlink(server->path);
+  free(server->path);
+  free(server->records);
+  free(server);
+}
+
+static void hosp_server_accept(hosp_server* server) {
+  struct hosp_server_client* client;
+  size_t i;
+  int fd;
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+#endif
+  while ((fd = accept(server->fd, NULL, NULL)) >= 0) {
+    for (i = 0, client = NULL; i < HOSP_SERVER_MAX_CLIENTS; i++) {
+      if (server->clients[i].fd < 0) {
+        client = &server->clients[i];
+        break;
+      }
+    }
+    if (client == NULL || hosp_server_set_nonblocking(fd) ||
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one)) ||
+#endif
+        (client != NULL && (client->out = malloc(HOSP_SERVER_BUF_SIZE)) == NULL)) {
+      // too many subscribers, or out of resources
+      close(fd);
+      continue;
+    }
+    client->fd = fd;
+  }
+}
+
+static uint64_t hosp_server_oldest(const hosp_server* server) {
+  return server->head > server->backlog ? server->head - server->backlog : 0;
+}
+
+// Returns 0 on success, -1 if the client disconnected or failed
+static int hosp_server_recv_request(hosp_server* server, struct hosp_server_client* client) {
+  ssize_t ret = recv(client->fd, client->req + client->req_len, HOSP_SERVER_REQUEST_SIZE - client->req_len, 0);
+  if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    return -1;
+  }
+  if (ret > 0 && (client->req_len += (size_t) ret) == HOSP_SERVER_REQUEST_SIZE) {
+    client->cursor = hosp_server_get_u64(client->req);
+    if (client->cursor > server->head) {
+      client->cursor = server->head;
+    } else if (client->cursor < hosp_server_oldest(server)) {
+      client->cursor = hosp_server_oldest(server);
+    }
+    client->is_subscribed = 1;
+  }
+  return 0;
+}
+
+// Encode pending rounds into frames in the client's send buffer, as space allows
+static void hosp_server_fill(const hosp_server* server, struct hosp_server_client* client) {
+  unsigned char* ptr;
+  size_t count;
+  size_t i;
+  if (client->out_off) {
+    memmove(client->out, client->out + client->out_off, client->out_len - client->out_off);
+    client->out_len -= client->out_off;
+    client->out_off = 0;
+  }
+  while (client->cursor < server->head &&
+         HOSP_SERVER_BUF_SIZE - client->out_len >= HOSP_SERVER_FRAME_HEADER_SIZE + server->record_size) {
+    count = (HOSP_SERVER_BUF_SIZE - client->out_len - HOSP_SERVER_FRAME_HEADER_SIZE) / server->record_size;
+    if (count > server->head - client->cursor) {
+      count = (size_t) (server->head - client->cursor);
+    }
+    ptr = client->out + client->out_len;
+    hosp_server_put_u32(ptr, (uint32_t) (HOSP_SERVER_FRAME_HEADER_SIZE - 4 + count * server->record_size));
+    hosp_server_put_u64(ptr + 4, client->cursor);
+    hosp_server_put_u32(ptr + 12, (uint32_t) count);
+    hosp_server_put_u32(ptr + 16, (uint32_t) server->num_devices);
+    ptr += HOSP_SERVER_FRAME_HEADER_SIZE;
+    for (i = 0; i < count; i++, ptr += server->record_size, client->cursor++) {
+      memcpy(ptr, &server->records[(client->cursor % server->backlog) * server->record_size], server->record_size);
+    }
+    client->out_len = (size_t) (ptr - client->out);
+  }
+}
+
+// Returns 0 on success, including if the socket would block, -1 if the client disconnected or failed
+static int hosp_server_flush(struct hosp_server_client* client) {
+  ssize_t ret;
+  while (client->out_off < client->out_len) {
+    ret = send(client->fd, client->out + client->out_off, client->out_len - client->out_off, HOSP_SERVER_SEND_FLAGS);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    client->out_off += (size_t) ret;
+  }
+  client->out_off = 0;
+  client->out_len = 0;
+  return 0;
+}
+
+void hosp_server_publish(hosp_server* server, uint64_t timestamp_ns, const hosp_sample* samples, const int* status) {
+  struct hosp_server_client* client;
+  size_t i;
+  hosp_log_encode_record(&server->records[(server->head % server->backlog) * server->record_size], timestamp_ns,
+                         samples, status, server->num_devices);
+  server->head++;
+  hosp_server_accept(server);
+  for (i = 0; i < HOSP_SERVER_MAX_CLIENTS; i++) {
+    client = &server->clients[i];
+    if (client->fd < 0) {
+      continue;
+    }
+    if (!client->is_subscribed) {
+      if (hosp_server_recv_request(server, client)) {
+        hosp_server_disconnect(client);
+      }
+      if (!client->is_subscribed) {
+        continue;
+      }
+    }
+    if (client->cursor < hosp_server_oldest(server)) {
+      // the rounds it needs next are gone, so it can't keep up
+      server->dropped++;
+      hosp_server_disconnect(client);
+      continue;
+    }
+    hosp_server_fill(server, client);
+    if (hosp_server_flush(client)) {
+      hosp_server_disconnect(client);
+    }
+  }
+}
+
+unsigned long hosp_server_get_dropped(const hosp_server* server) {
+  return server->dropped;
+}
@@ -0,0 +1,53 @@
+/**
+ * A Unix domain socket server that streams poll rounds to subscribers, with history replay.
+ *
+ * Protocol (all integers are little-endian):
+ * - After connecting, a client sends a uint64_t sequence number, the first poll round it wants.
+ *   Rounds still in the backlog are replayed from there, and new rounds follow as they're polled.
+ *   UINT64_MAX requests only new rounds.
+ * - The server sends frames, each with a batch of consecutive rounds:
+ *     uint32_t length of the rest of the frame
+ *     uint64_t sequence number of the first round in the frame
+ *     uint32_t number of rounds
+ *     uint32_t number of devices
+ *     rounds: binary log records, see hosp-log.h
+ *   If the requested round is no longer in the backlog, the first frame starts at the oldest round still available,
+ *   which clients can detect by its sequence number.
+ *
+ * The server never blocks sampling: sockets are non-blocking, each subscriber has a bounded send buffer, and a
+ * subscriber that falls more than the backlog behind is disconnected and counted as dropped.
+ */
+#ifndef _HOSP_SERVER_H_
+#define _HOSP_SERVER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hosp.h>
+
+#pragma GCC visibility push(hidden)
+
+typedef struct hosp_server hosp_server;
+
+// Listen on a Unix domain socket path, replacing any existing socket; returns NULL on failure (sets errno)
+hosp_server* hosp_server_open(const char* path, size_t num_devices, size_t backlog);
+
+// Stop listening, disconnect subscribers, and remove the socket path
+void hosp_server_close(hosp_server* server);
+
+// Add a poll round to the backlog, then accept new subscribers and send them pending rounds, all without blocking
+void hosp_server_publish(hosp_server* server, uint64_t timestamp_ns, const hosp_sample* samples, const int* status);
+
+// Get the number of subscribers dropped for falling behind
+unsigned long hosp_server_get_dropped(const hosp_server* server);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
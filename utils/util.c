@@ -5,14 +5,24 @@
  * @date 2018-05-22
  */
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #if defined(_WIN32)
 #include <windows.h>
 #else
 #include <unistd.h>
 #endif
 #include <hosp.h>
+#include <hosp-group.h>
+#include "hosp-time.h"
 #include "util.h"
 
+static int read_timeout_ms = HOSP_READ_TIMEOUT_MS;
+static unsigned int read_retries = HOSP_READ_RETRIES;
+
 int hosp_util_msleep(unsigned long ms) {
 #if defined(_WIN32)
   Sleep(ms);
@@ -22,15 +32,60 @@ int hosp_util_msleep(unsigned long ms) {
 #endif
 }
 
+void hosp_util_set_read_policy(int timeout_ms, unsigned int retries) {
+  read_timeout_ms = timeout_ms;
+  read_retries = retries;
+}
+
+int hosp_util_parse_timeout(const char* str, int* timeout_ms) {
+  char* end;
+  long val;
+  errno = 0;
+  val = strtol(str, &end, 0);
+  if (errno || end == str || *end != '\0' || val < -1 || val > INT_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+  *timeout_ms = (int) val;
+  return 0;
+}
+
+int hosp_util_parse_u64(const char* str, uint64_t min, uint64_t max, uint64_t* val) {
+  char* end;
+  unsigned long long v;
+  errno = 0;
+  v = strtoull(str, &end, 0);
+  // strtoull negates negative values instead of rejecting them
+  if (errno || end == str || *end != '\0' || strchr(str, '-') != NULL || v < min || v > max) {
+    errno = EINVAL;
+    return -1;
+  }
+  *val = (uint64_t) v;
+  return 0;
+}
+
+int hosp_util_parse_seconds(const char* str, double min, double max, double* val) {
+  char* end;
+  double v;
+  errno = 0;
+  v = strtod(str, &end);
+  // also rejects NaN
+  if (errno || end == str || *end != '\0' || !(v >= min && v <= max)) {
+    errno = EINVAL;
+    return -1;
+  }
+  *val = v;
+  return 0;
+}
+
 int hosp_util_get_version(hosp_device* hosp, char* version, size_t len) {
   unsigned int i;
   int ret;
-  if (hosp_request_version_write(hosp)) {
-    return -1;
-  }
-  for (i = 0; i < HOSP_READ_RETRIES; i++) {
-    hosp_util_msleep(HOSP_WRITE_READ_DELAY_MS);
-    if ((ret = hosp_request_version_read(hosp, version, len)) < 0) {
+  for (i = 0; i <= read_retries; i++) {
+    if (hosp_request_version_write(hosp)) {
+      return -1;
+    }
+    if ((ret = hosp_request_version_read_timeout(hosp, version, len, read_timeout_ms)) < 0) {
       return ret;
     } else if (!ret) {
       return 0;
@@ -43,12 +98,11 @@ int hosp_util_get_version(hosp_device* hosp, char* version, size_t len) {
 int hosp_util_get_status(hosp_device* hosp, int* is_on, int* is_started) {
   unsigned int i;
   int ret;
-  if (hosp_request_status_write(hosp)) {
-    return -1;
-  }
-  for (i = 0; i < HOSP_READ_RETRIES; i++) {
-    hosp_util_msleep(HOSP_WRITE_READ_DELAY_MS);
-    if ((ret = hosp_request_status_read(hosp, is_on, is_started)) < 0) {
+  for (i = 0; i <= read_retries; i++) {
+    if (hosp_request_status_write(hosp)) {
+      return -1;
+    }
+    if ((ret = hosp_request_status_read_timeout(hosp, is_on, is_started, read_timeout_ms)) < 0) {
       return ret;
     } else if (!ret) {
       return 0;
@@ -61,12 +115,11 @@ int hosp_util_get_status(hosp_device* hosp, int* is_on, int* is_started) {
 int hosp_util_get_data(hosp_device* hosp, unsigned int* mV, unsigned int* mA, unsigned int* mW, unsigned int* mWh) {
   unsigned int i;
   int ret;
-  if (hosp_request_data_write(hosp)) {
-    return -1;
-  }
-  for (i = 0; i < HOSP_READ_RETRIES; i++) {
-    hosp_util_msleep(HOSP_WRITE_READ_DELAY_MS);
-    if ((ret = hosp_request_data_read(hosp, mV, mA, mW, mWh)) < 0) {
+  for (i = 0; i <= read_retries; i++) {
+    if (hosp_request_data_write(hosp)) {
+      return -1;
+    }
+    if ((ret = hosp_request_data_read_timeout(hosp, mV, mA, mW, mWh, read_timeout_ms)) < 0) {
       return ret;
     } else if (!ret) {
       return 0;
@@ -75,3 +128,114 @@ int hosp_util_get_data(hosp_device* hosp, unsigned int* mV, unsigned int* mA, un
   errno = ENODATA;
   return -1;
 }
+
+size_t hosp_util_group_get_data(hosp_group* group, hosp_sample* samples, int* status) {
+  hosp_device* hosp;
+  size_t n;
+  size_t i;
+  unsigned int r;
+  // this only sends requests to devices that don't already have one outstanding
+  hosp_group_request_data_write(group);
+  n = hosp_group_request_data_read_timeout(group, samples, status, read_timeout_ms);
+  // resend requests that timed out, which were abandoned, one device at a time since this should be rare
+  for (i = 0; i < hosp_group_size(group); i++) {
+    hosp = hosp_group_get_device(group, i);
+    for (r = 0; r < read_retries && status[i] > 0; r++) {
+      if (hosp_request_data_write(hosp)) {
+        status[i] = -errno;
+      } else if (!(status[i] = hosp_request_data_read_timeout(hosp, &samples[i].mV, &samples[i].mA, &samples[i].mW,
+                                                              &samples[i].mWh, read_timeout_ms))) {
+        samples[i].timestamp_ns = hosp_time_ns();
+        n++;
+      }
+    }
+  }
+  return n;
+}
+
+// Returns the exclusive upper bound (in us) of the latency bucket containing the quantile, or 0 if there's no data
+static uint64_t latency_quantile_us(const hosp_stats* stats, uint64_t total, double q) {
+  uint64_t target = (uint64_t) (q * (double) total);
+  uint64_t sum = 0;
+  unsigned int i;
+  for (i = 0; i < HOSP_STATS_LATENCY_BUCKETS; i++) {
+    if ((sum += stats->latency[i]) > target) {
+      return UINT64_C(1) << i;
+    }
+  }
+  return total ? UINT64_C(1) << (HOSP_STATS_LATENCY_BUCKETS - 1) : 0;
+}
+
+void hosp_util_print_stats(FILE* f, const char* label, const hosp_stats* stats, int histogram) {
+  uint64_t total = 0;
+  unsigned int i;
+  for (i = 0; i < HOSP_STATS_LATENCY_BUCKETS; i++) {
+    total += stats->latency[i];
+  }
+  fprintf(f, "%s: writes=%llu write_errors=%llu reads=%llu not_ready=%llu read_errors=%llu "
+          "latency_us: p50<%llu p90<%llu p99<%llu\n", label,
+          (unsigned long long) stats->writes, (unsigned long long) stats->write_errors,
+          (unsigned long long) stats->reads, (unsigned long long) stats->reads_not_ready,
+          (unsigned long long) stats->read_errors,
+          (unsigned long long) latency_quantile_us(stats, total, 0.5),
+          (unsigned long long) latency_quantile_us(stats, total, 0.9),
+          (unsigned long long) latency_quantile_us(stats, total, 0.99));
+  if (histogram) {
+    for (i = 0; i < HOSP_STATS_LATENCY_BUCKETS; i++) {
+      if (stats->latency[i]) {
+        fprintf(f, "  latency [%llu, %llu%s us: %llu\n",
+                (unsigned long long) (i ? UINT64_C(1) << (i - 1) : 0), (unsigned long long) (UINT64_C(1) << i),
+                i < HOSP_STATS_LATENCY_BUCKETS - 1 ? ")" : "+)", (unsigned long long) stats->latency[i]);
+      }
+    }
+  }
+}
+
+int hosp_util_get_snapshot(hosp_device* hosp, char* version, size_t len, int* is_on, int* is_started,
+                           hosp_sample* sample) {
+  unsigned int i;
+  int ret;
+  for (i = 0; i <= read_retries; i++) {
+    if ((ret = hosp_snapshot(hosp, version, len, is_on, is_started, sample, read_timeout_ms)) <= 0) {
+      return ret;
+    }
+  }
+  errno = ENODATA;
+  return -1;
+}
+
+int hosp_util_restart(hosp_device* hosp) {
+  int ret = 0;
+  int is_on;
+  int is_started;
+  // get current status
+  if (hosp_util_get_status(hosp, &is_on, &is_started)) {
+    ret = errno;
+    perror("Failed to get status from ODROID Smart Power");
+    return ret;
+  }
+  if (!is_on) {
+    // turn on
+    if (hosp_request_onoff_write(hosp)) {
+      ret = errno;
+      perror("Failed to turn on ODROID Smart Power");
+      return ret;
+    }
+  } else if (is_started) {
+    // stop
+    if (hosp_request_startstop_write(hosp)) {
+      ret = errno;
+      perror("Failed to stop ODROID Smart Power");
+      return ret;
+    }
+  }
+  // start
+  if (hosp_request_startstop_write(hosp)) {
+    ret = errno;
+    perror("Failed to start ODROID Smart Power");
+    return ret;
+  }
+  // allow time for counter to restart
+  hosp_util_msleep(HOSP_RESTART_DELAY_MS);
+  return 0;
+}
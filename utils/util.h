@@ -12,24 +12,61 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <hosp.h>
+#include <hosp-group.h>
 
 #pragma GCC visibility push(hidden)
 
-// Time wait between writing a command the reading the response
-#define HOSP_WRITE_READ_DELAY_MS 1
+// Default to waiting up to 1/4 second for a response
+#define HOSP_READ_TIMEOUT_MS 250
 
-// Try for up to 1/4 second
-#define HOSP_READ_RETRIES 250
+// Default to not resending requests that time out
+#define HOSP_READ_RETRIES 0
+
+// The longest durations, in milliseconds and seconds, whose nanoseconds fit in a uint64_t
+#define HOSP_UTIL_MS_MAX (UINT64_MAX / UINT64_C(1000000))
+#define HOSP_UTIL_S_MAX ((double) (UINT64_MAX / UINT64_C(1000000000)))
+
+// Time to wait for the Watt-hour counter to restart
+#define HOSP_RESTART_DELAY_MS 100
 
 int hosp_util_msleep(unsigned long ms);
 
+// Set how long to wait for a response (-1 to wait indefinitely), and how many times to resend a request that times out
+// (a request that times out is abandoned, so its late response is discarded rather than answering the resent one)
+void hosp_util_set_read_policy(int timeout_ms, unsigned int retries);
+
+// Parse a timeout in milliseconds that's >= -1, returning 0 on success or -1 if it's malformed or out of range
+int hosp_util_parse_timeout(const char* str, int* timeout_ms);
+
+// Parse an unsigned integer in [min, max], returning 0 on success or -1 if it's malformed or out of range
+int hosp_util_parse_u64(const char* str, uint64_t min, uint64_t max, uint64_t* val);
+
+// Parse a number of seconds in [min, max], returning 0 on success or -1 if it's malformed or out of range
+int hosp_util_parse_seconds(const char* str, double min, double max, double* val);
+
 int hosp_util_get_version(hosp_device* hosp, char* version, size_t len);
 
 int hosp_util_get_status(hosp_device* hosp, int* is_on, int* is_started);
 
 int hosp_util_get_data(hosp_device* hosp, unsigned int* mv, unsigned int* ma, unsigned int* mw, unsigned int* mWh);
 
+// Get the version, status, and data in one pipelined exchange (see hosp_snapshot)
+int hosp_util_get_snapshot(hosp_device* hosp, char* version, size_t len, int* is_on, int* is_started,
+                           hosp_sample* sample);
+
+// Turn on the device if needed and restart its Watt-hour counter, returning 0 on success or errno on failure (prints)
+int hosp_util_restart(hosp_device* hosp);
+
+// Get data from all devices in a group, returning the number of devices read (see hosp_group_request_data_read_timeout)
+// Requests already written with hosp_group_request_data_write() aren't sent again
+size_t hosp_util_group_get_data(hosp_group* group, hosp_sample* samples, int* status);
+
+// Print device statistics on a single line, followed by the non-empty latency histogram buckets if histogram is set
+void hosp_util_print_stats(FILE* f, const char* label, const hosp_stats* stats, int histogram);
+
 #pragma GCC visibility pop
 
 #ifdef __cplusplus
@@ -0,0 +1,64 @@
+/**
+ * Windowed power aggregation for utilities.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "window.h"
+
+void hosp_window_reset(hosp_window* window, uint64_t start_uJ) {
+  memset(window, 0, sizeof(*window));
+  window->min_mW = UINT32_MAX;
+  window->start_uJ = start_uJ;
+}
+
+static unsigned int hosp_window_bucket(unsigned int mW) {
+  unsigned int shift;
+  if (mW < 2 * HOSP_WINDOW_SUB_BUCKETS) {
+    return mW;
+  }
+  // keep the HOSP_WINDOW_SUB_BITS bits below the most significant bit
+  shift = 31 - (unsigned int) __builtin_clz(mW) - HOSP_WINDOW_SUB_BITS;
+  return (shift + 1) * HOSP_WINDOW_SUB_BUCKETS + (mW >> shift) - HOSP_WINDOW_SUB_BUCKETS;
+}
+
+// Returns the middle of the range of values in a bucket
+static unsigned int hosp_window_bucket_value(unsigned int bucket) {
+  unsigned int shift;
+  if (bucket < 2 * HOSP_WINDOW_SUB_BUCKETS) {
+    return bucket;
+  }
+  shift = bucket / HOSP_WINDOW_SUB_BUCKETS - 1;
+  return ((bucket % HOSP_WINDOW_SUB_BUCKETS + HOSP_WINDOW_SUB_BUCKETS) << shift) + ((1U << shift) >> 1);
+}
+
+void hosp_window_add(hosp_window* window, unsigned int mW) {
+  window->count++;
+  window->sum_mW += mW;
+  if (mW < window->min_mW) {
+    window->min_mW = mW;
+  }
+  if (mW > window->max_mW) {
+    window->max_mW = mW;
+  }
+  window->buckets[hosp_window_bucket(mW)]++;
+}
+
+unsigned int hosp_window_percentile(const hosp_window* window, unsigned int p) {
+  // the rank of the percentile value, rounded up
+  uint64_t rank = (window->count * p + 99) / 100;
+  uint64_t seen = 0;
+  unsigned int val;
+  unsigned int i;
+  if (rank >= window->count) {
+    // the maximum is known exactly, but would be estimated from the middle of its bucket, which may be lower
+    return window->max_mW;
+  }
+  for (i = 0; i < HOSP_WINDOW_BUCKETS; i++) {
+    if ((seen += window->buckets[i]) >= rank) {
+      break;
+    }
+  }
+  // the estimate can't be outside the known extremes
+  val = hosp_window_bucket_value(i);
+  return val < window->min_mW ? window->min_mW : val > window->max_mW ? window->max_mW : val;
+}
@@ -0,0 +1,47 @@
+/**
+ * Windowed power aggregation for utilities.
+ *
+ * Power percentiles are estimated in constant memory with a log-linear histogram sketch (like HDR Histogram):
+ * values below 2^(HOSP_WINDOW_SUB_BITS+1) mW are exact, and larger values fall in one of 2^HOSP_WINDOW_SUB_BITS
+ * sub-buckets per power of two, so estimates are within 1/2^(HOSP_WINDOW_SUB_BITS+1) of the true value.
+ */
+#ifndef _HOSP_WINDOW_H_
+#define _HOSP_WINDOW_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#pragma GCC visibility push(hidden)
+
+#define HOSP_WINDOW_SUB_BITS 5
+#define HOSP_WINDOW_SUB_BUCKETS (1U << HOSP_WINDOW_SUB_BITS)
+#define HOSP_WINDOW_BUCKETS ((32U - HOSP_WINDOW_SUB_BITS + 1) * HOSP_WINDOW_SUB_BUCKETS)
+
+typedef struct hosp_window {
+  uint64_t count;
+  uint64_t sum_mW;
+  unsigned int min_mW;
+  unsigned int max_mW;
+  // energy accumulator value when the window started
+  uint64_t start_uJ;
+  uint32_t buckets[HOSP_WINDOW_BUCKETS];
+} hosp_window;
+
+// Reset a window, which starts at the given energy accumulator value
+void hosp_window_reset(hosp_window* window, uint64_t start_uJ);
+
+void hosp_window_add(hosp_window* window, unsigned int mW);
+
+// Estimate the p-th percentile (0 < p <= 100) of power added to a non-empty window
+unsigned int hosp_window_percentile(const hosp_window* window, unsigned int p);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,246 @@
+/**
+ * Write records to a file descriptor on a separate thread, so a slow consumer never stalls the producer.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hosp-time.h"
+#include "writer.h"
+
+// the batch size, unless flushing by bytes needs a larger one
+#define HOSP_WRITER_BATCH_SIZE 65536
+
+struct hosp_writer {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  int fd;
+  hosp_writer_overflow overflow;
+  hosp_writer_flush flush;
+  uint64_t flush_arg;
+  // queued records, in slots of record_max bytes
+  size_t capacity;
+  size_t record_max;
+  unsigned char* slots;
+  size_t* lens;
+  size_t head;
+  size_t len;
+  int is_stopping;
+  // set if writing fails, after which the queue is discarded
+  int err;
+  uint64_t dropped;
+  // only used by the writer thread
+  unsigned char* batch;
+  size_t batch_size;
+  size_t batch_len;
+  // when the oldest batched record was batched
+  uint64_t batch_ns;
+};
+
+// Returns 0 on success, errno on failure
+static int hosp_writer_write(int fd, const unsigned char* buf, size_t len) {
+  ssize_t ret;
+  while (len) {
+    if ((ret = write(fd, buf, len)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    }
+    buf += ret;
+    len -= (size_t) ret;
+  }
+  return 0;
+}
+
+// Returns 1 if the batch should be written now
+static int hosp_writer_is_due(const hosp_writer* writer) {
+  switch (writer->flush) {
+    case HOSP_WRITER_FLUSH_BYTES:
+      return writer->batch_len >= writer->flush_arg;
+    case HOSP_WRITER_FLUSH_MS:
+      return hosp_time_ns() - writer->batch_ns >= writer->flush_arg * HOSP_NS_PER_MS;
+    case HOSP_WRITER_FLUSH_RECORD:
+    default:
+      return 1;
+  }
+}
+
+// Wait for a record to be queued, or until the batch is due if flushing by time
+static void hosp_writer_wait(hosp_writer* writer) {
+  uint64_t due_ns;
+  if (writer->flush != HOSP_WRITER_FLUSH_MS || !writer->batch_len) {
+    pthread_cond_wait(&writer->not_empty, &writer->lock);
+    return;
+  }
+  due_ns = writer->batch_ns + writer->flush_arg * HOSP_NS_PER_MS;
+  if (hosp_time_ns() >= due_ns) {
+    return;
+  }
+  hosp_time_cond_timedwait_ns(&writer->not_empty, &writer->lock, due_ns);
+}
+
+static void* hosp_writer_run(void* arg) {
+  hosp_writer* writer = (hosp_writer*) arg;
+  int is_full;
+  int err;
+  pthread_mutex_lock(&writer->lock);
+  for (;;) {
+    // move queued records into the batch as they fit, so the producer can reuse their slots while we write
+    if (writer->len) {
+      if (!writer->batch_len) {
+        writer->batch_ns = hosp_time_ns();
+      }
+      for (; writer->len && writer->batch_len + writer->lens[writer->head] <= writer->batch_size; writer->len--) {
+        memcpy(&writer->batch[writer->batch_len], &writer->slots[writer->head * writer->record_max],
+               writer->lens[writer->head]);
+        writer->batch_len += writer->lens[writer->head];
+        writer->head = (writer->head + 1) % writer->capacity;
+      }
+      pthread_cond_signal(&writer->not_full);
+    }
+    is_full = writer->len > 0;
+    if (writer->batch_len && (is_full || writer->is_stopping || hosp_writer_is_due(writer))) {
+      pthread_mutex_unlock(&writer->lock);
+      err = hosp_writer_write(writer->fd, writer->batch, writer->batch_len);
+      pthread_mutex_lock(&writer->lock);
+      writer->batch_len = 0;
+      if (err) {
+        writer->err = err;
+        writer->len = 0;
+        // wake a producer blocked on a full queue
+        pthread_cond_signal(&writer->not_full);
+        break;
+      }
+      continue;
+    }
+    if (writer->is_stopping && !writer->len) {
+      // everything was written
+      break;
+    }
+    if (!writer->len) {
+      hosp_writer_wait(writer);
+    }
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return NULL;
+}
+
+static void hosp_writer_free(hosp_writer* writer) {
+  free(writer->batch);
+  free(writer->lens);
+  free(writer->slots);
+  free(writer);
+}
+
+hosp_writer* hosp_writer_start(int fd, size_t capacity, size_t record_max, hosp_writer_overflow overflow,
+                               hosp_writer_flush flush, uint64_t flush_arg) {
+  hosp_writer* writer;
+  sigset_t set;
+  sigset_t old;
+  int err;
+  if (!capacity || !record_max || record_max > HOSP_WRITER_BATCH_SIZE || capacity > SIZE_MAX / record_max ||
+      (flush == HOSP_WRITER_FLUSH_BYTES && flush_arg > SIZE_MAX)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((writer = calloc(1, sizeof(hosp_writer))) == NULL) {
+    return NULL;
+  }
+  writer->fd = fd;
+  writer->overflow = overflow;
+  writer->flush = flush;
+  writer->flush_arg = flush_arg;
+  writer->capacity = capacity;
+  writer->record_max = record_max;
+  writer->batch_size = HOSP_WRITER_BATCH_SIZE;
+  if (flush == HOSP_WRITER_FLUSH_BYTES && flush_arg > writer->batch_size) {
+    writer->batch_size = (size_t) flush_arg;
+  }
+  if ((writer->slots = malloc(capacity * record_max)) == NULL ||
+      (writer->lens = malloc(capacity * sizeof(size_t))) == NULL ||
+      (writer->batch = malloc(writer->batch_size)) == NULL) {
+    hosp_writer_free(writer);
+    errno = ENOMEM;
+    return NULL;
+  }
+  pthread_mutex_init(&writer->lock, NULL);
+  hosp_time_cond_init(&writer->not_empty);
+  pthread_cond_init(&writer->not_full, NULL);
+  // signals are for the producer; the writer sees a closed pipe as an EPIPE error instead of terminating the process
+  sigfillset(&set);
+  pthread_sigmask(SIG_SETMASK, &set, &old);
+  err = pthread_create(&writer->thread, NULL, hosp_writer_run, writer);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err) {
+    pthread_cond_destroy(&writer->not_full);
+    pthread_cond_destroy(&writer->not_empty);
+    pthread_mutex_destroy(&writer->lock);
+    hosp_writer_free(writer);
+    errno = err;
+    return NULL;
+  }
+  return writer;
+}
+
+int hosp_writer_stop(hosp_writer* writer) {
+  int err;
+  pthread_mutex_lock(&writer->lock);
+  writer->is_stopping = 1;
+  pthread_cond_signal(&writer->not_empty);
+  pthread_mutex_unlock(&writer->lock);
+  pthread_join(writer->thread, NULL);
+  err = writer->err;
+  pthread_cond_destroy(&writer->not_full);
+  pthread_cond_destroy(&writer->not_empty);
+  pthread_mutex_destroy(&writer->lock);
+  hosp_writer_free(writer);
+  return err;
+}
+
+int hosp_writer_push(hosp_writer* writer, const void* buf, size_t len) {
+  size_t tail;
+  int err;
+  pthread_mutex_lock(&writer->lock);
+  if (writer->len == writer->capacity && !writer->err) {
+    switch (writer->overflow) {
+      case HOSP_WRITER_BLOCK:
+        while (writer->len == writer->capacity && !writer->err) {
+          pthread_cond_wait(&writer->not_full, &writer->lock);
+        }
+        break;
+      case HOSP_WRITER_DROP_OLDEST:
+        writer->head = (writer->head + 1) % writer->capacity;
+        writer->len--;
+        writer->dropped++;
+        break;
+      case HOSP_WRITER_DROP_NEWEST:
+      default:
+        writer->dropped++;
+        pthread_mutex_unlock(&writer->lock);
+        return 0;
+    }
+  }
+  if (!(err = writer->err)) {
+    tail = (writer->head + writer->len) % writer->capacity;
+    memcpy(&writer->slots[tail * writer->record_max], buf, len);
+    writer->lens[tail] = len;
+    writer->len++;
+    pthread_cond_signal(&writer->not_empty);
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return err;
+}
+
+uint64_t hosp_writer_get_dropped(hosp_writer* writer) {
+  uint64_t dropped;
+  pthread_mutex_lock(&writer->lock);
+  dropped = writer->dropped;
+  pthread_mutex_unlock(&writer->lock);
+  return dropped;
+}
@@ -0,0 +1,62 @@
+/**
+ * Write records to a file descriptor on a separate thread, so a slow consumer never stalls the producer.
+ *
+ * Records are copied into a bounded queue of fixed-size slots.
+ * The writer thread moves queued records into a batch, and writes the batch when the flush policy says it's due or when
+ * it's full, so a consumer that falls behind gets larger, fewer writes.
+ * When the queue is full, the overflow policy either blocks the producer until there's room or drops records.
+ */
+#ifndef _HOSP_WRITER_H_
+#define _HOSP_WRITER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma GCC visibility push(hidden)
+
+typedef enum hosp_writer_overflow {
+  // wait for the writer to make room
+  HOSP_WRITER_BLOCK,
+  // drop the oldest queued record
+  HOSP_WRITER_DROP_OLDEST,
+  // drop the new record
+  HOSP_WRITER_DROP_NEWEST
+} hosp_writer_overflow;
+
+typedef enum hosp_writer_flush {
+  // write records as soon as they're queued
+  HOSP_WRITER_FLUSH_RECORD,
+  // write once at least a number of bytes are batched
+  HOSP_WRITER_FLUSH_BYTES,
+  // write once the oldest batched record is a number of milliseconds old
+  HOSP_WRITER_FLUSH_MS
+} hosp_writer_flush;
+
+typedef struct hosp_writer hosp_writer;
+
+// Start a writer thread with a queue of capacity records, each up to record_max bytes, that writes batches according to
+// the flush policy and its bytes or milliseconds argument; returns NULL on failure (sets errno)
+hosp_writer* hosp_writer_start(int fd, size_t capacity, size_t record_max, hosp_writer_overflow overflow,
+                               hosp_writer_flush flush, uint64_t flush_arg);
+
+// Write the queued and batched records, then stop the writer thread; returns 0 on success, or errno if writing failed
+int hosp_writer_stop(hosp_writer* writer);
+
+// Queue a record of up to record_max bytes; returns 0 on success (even if a record was dropped), or errno if writing
+// failed, after which nothing more is written
+int hosp_writer_push(hosp_writer* writer, const void* buf, size_t len);
+
+// Get the number of records dropped because the queue was full
+uint64_t hosp_writer_get_dropped(hosp_writer* writer);
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif